@@ -0,0 +1,463 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/archive.h
+ *  Compile-time descriptors of the Dark Seed II archive formats, and the
+ *  directory readers and writers generated from them.
+ *
+ *  All archive formats share the same basic layout: an optional size field,
+ *  the number of files, then a directory with one entry per file, consisting
+ *  of a fixed-length name, the size and the offset of the file's data. They
+ *  only differ in the byte order, the field widths, the name length and
+ *  whether the offsets are relative to the end of the directory.
+ *
+ *  A format descriptor is a struct with these static members:
+ *
+ *  - kName:            Short name of the format, for messages
+ *  - kBigEndian:       All fields are big endian instead of little endian
+ *  - kHasSizeField:    The archive starts with a 32-bit size of the whole archive
+ *  - kCountSize:       Width of the file count field, 2 or 4 bytes
+ *  - kNameLength:      Length of the name within a directory entry
+ *  - kRelativeOffsets: Offsets are relative to the end of the directory
+ *  - kCompressible:    The whole archive might be a compressed glue
+ *  - kUpdatable:       Files can be replaced within an existing archive
+ *  - getNameSuffix():  Implicit extension appended to every name
+ *
+ *  Everything depending on these is resolved at compile time.
+ */
+
+#ifndef COMMON_ARCHIVE_H
+#define COMMON_ARCHIVE_H
+
+#include <cstring>
+#include <strings.h>
+
+#include <list>
+#include <vector>
+#include <string>
+#include <istream>
+
+#include "common/types.h"
+#include "common/util.h"
+
+namespace Common {
+
+/** PGF archives, found in the Sega Saturn versions. */
+struct PGFFormat {
+	static const char *const kName;
+
+	static const bool   kBigEndian       = true;
+	static const bool   kHasSizeField    = false;
+	static const uint32 kCountSize       = 4;
+	static const uint32 kNameLength      = 12;
+	static const bool   kRelativeOffsets = true;
+	static const bool   kCompressible    = false;
+	static const bool   kUpdatable       = true;
+
+	static const char *getNameSuffix() { return ""; }
+};
+
+/** TND archives, found in the Sega Saturn versions (inside PGF archives). */
+struct TNDFormat {
+	static const char *const kName;
+
+	static const bool   kBigEndian       = true;
+	static const bool   kHasSizeField    = true;
+	static const uint32 kCountSize       = 4;
+	static const uint32 kNameLength      = 8;
+	static const bool   kRelativeOffsets = true;
+	static const bool   kCompressible    = false;
+	static const bool   kUpdatable       = true;
+
+	static const char *getNameSuffix() { return ".TXT"; }
+};
+
+/** Glue archives, found in the Windows versions. */
+struct GlueFormat {
+	static const char *const kName;
+
+	static const bool   kBigEndian       = false;
+	static const bool   kHasSizeField    = false;
+	static const uint32 kCountSize       = 2;
+	static const uint32 kNameLength      = 12;
+	static const bool   kRelativeOffsets = false;
+	static const bool   kCompressible    = true;
+	static const bool   kUpdatable       = false;
+
+	static const char *getNameSuffix() { return ""; }
+};
+
+/** Information about a file within an archive. */
+struct FileInfo {
+	char name[13];
+	uint32 offset;
+	uint32 size;
+
+	FileInfo(const char *n = "", uint32 o = 0, uint32 s = 0) : offset(o), size(s) {
+		strncpy(name, n, 12);
+		name[12] = '\0';
+	}
+};
+
+/** Reading and writing fields in a specific byte order. */
+template<bool kBigEndian> struct ByteOrder;
+
+template<> struct ByteOrder<true> {
+	static uint32 read16 (const byte *data) { return readUint16BE(data); }
+	static uint32 read32 (const byte *data) { return readUint32BE(data); }
+	static void   write16(byte *data, uint32 x) { writeUint16BE(data, x); }
+	static void   write32(byte *data, uint32 x) { writeUint32BE(data, x); }
+};
+
+template<> struct ByteOrder<false> {
+	static uint32 read16 (const byte *data) { return readUint16LE(data); }
+	static uint32 read32 (const byte *data) { return readUint32LE(data); }
+	static void   write16(byte *data, uint32 x) { writeUint16LE(data, x); }
+	static void   write32(byte *data, uint32 x) { writeUint32LE(data, x); }
+};
+
+/** The layout of an archive format, derived from its descriptor. */
+template<class Format> struct ArchiveLayout {
+	typedef ByteOrder<Format::kBigEndian> Order;
+
+	/** Size of the archive header: size field and file count. */
+	static const uint32 kHeaderSize = (Format::kHasSizeField ? 4 : 0) + Format::kCountSize;
+	/** Offset of the file count within the header. */
+	static const uint32 kCountOffset = Format::kHasSizeField ? 4 : 0;
+	/** Size of a directory entry: name, size and offset. */
+	static const uint32 kEntrySize = Format::kNameLength + 4 + 4;
+
+	/** Return the offset of the first byte after the directory.
+	 *
+	 *  Computed in 64 bits, since the count comes from untrusted headers.
+	 */
+	static uint64 getDataStart(uint32 count) {
+		return kHeaderSize + (uint64) count * kEntrySize;
+	}
+
+	static uint32 readCount(const byte *header) {
+		return (Format::kCountSize == 2) ? Order::read16(header + kCountOffset) : Order::read32(header + kCountOffset);
+	}
+
+	static void writeCount(byte *header, uint32 count) {
+		if (Format::kCountSize == 2)
+			Order::write16(header + kCountOffset, count);
+		else
+			Order::write32(header + kCountOffset, count);
+	}
+};
+
+/** Read and verify an archive's header, returning the number of files.
+ *
+ *  The stream is left positioned at the start of the directory.
+ */
+template<class Format>
+bool readArchiveHeader(std::istream &stream, uint32 &count) {
+	typedef ArchiveLayout<Format> Layout;
+
+	byte header[Layout::kHeaderSize];
+
+	stream.seekg(0, std::ios_base::beg);
+	stream.read((char *) header, Layout::kHeaderSize);
+
+	if ((uint32) stream.gcount() != Layout::kHeaderSize)
+		return false;
+
+	// The size field has to match the real size
+	if (Format::kHasSizeField) {
+		uint32 streamSize = getSize(stream);
+		if (streamSize == 0xFFFFFFFF) {
+			// A stream that can't tell its size, like a pipe, can't be checked
+			stream.clear();
+			stream.seekg(Layout::kHeaderSize, std::ios_base::beg);
+		} else if (Layout::Order::read32(header) != streamSize)
+			return false;
+	}
+
+	count = Layout::readCount(header);
+	return true;
+}
+
+/** Parse a directory, read from an archive in one go. */
+template<class Format>
+void parseFileList(const byte *dir, uint32 count, std::list<FileInfo> &files) {
+	typedef ArchiveLayout<Format> Layout;
+
+	const uint32 offsetBias = Format::kRelativeOffsets ? Layout::getDataStart(count) : 0;
+	const size_t suffixLength = strlen(Format::getNameSuffix());
+
+	for (uint32 i = 0; i < count; i++, dir += Layout::kEntrySize) {
+		FileInfo file;
+
+		memcpy(file.name, dir, Format::kNameLength);
+		file.name[Format::kNameLength] = '\0';
+
+		if (suffixLength > 0)
+			strncat(file.name, Format::getNameSuffix(), 12 - strlen(file.name));
+
+		file.size   = Layout::Order::read32(dir + Format::kNameLength);
+		file.offset = Layout::Order::read32(dir + Format::kNameLength + 4) + offsetBias;
+
+		files.push_back(file);
+	}
+}
+
+/** Read the directory of an archive, after readArchiveHeader(). */
+template<class Format>
+bool readFileList(std::istream &stream, std::list<FileInfo> &files, uint32 count) {
+	typedef ArchiveLayout<Format> Layout;
+
+	const uint64 dirSize = (uint64) count * Layout::kEntrySize;
+
+	// The directory has to fit into the archive
+	const uint32 streamPos  = stream.tellg();
+	const uint32 streamSize = getSize(stream);
+	if ((streamSize != 0xFFFFFFFF) && ((Layout::kHeaderSize + dirSize) > streamSize))
+		return false;
+
+	stream.clear();
+	stream.seekg(streamPos, std::ios_base::beg);
+
+	/* A stream that can't tell its size, like a pipe, is read in pieces, so
+	 * that a bogus count can't make us allocate more than actually arrives. */
+	static const uint32 kPieceSize = 64 * 1024;
+
+	std::vector<byte> dir;
+	while (dir.size() < dirSize) {
+		const uint32 pieceSize = MIN<uint64>(dirSize - dir.size(), kPieceSize);
+		const size_t pieceStart = dir.size();
+
+		dir.resize(pieceStart + pieceSize);
+
+		stream.read((char *) &dir[pieceStart], pieceSize);
+		if ((uint32) stream.gcount() != pieceSize)
+			return false;
+	}
+
+	parseFileList<Format>(dir.empty() ? 0 : &dir[0], count, files);
+	return true;
+}
+
+/** Read an archive's header and directory. */
+template<class Format>
+bool readArchive(std::istream &stream, std::list<FileInfo> &files) {
+	uint32 count;
+	if (!readArchiveHeader<Format>(stream, count))
+		return false;
+
+	return readFileList<Format>(stream, files, count);
+}
+
+/** Parse the header and directory of a whole archive in memory.
+ *
+ *  Unlike readArchive(), this also makes sure that all files lie within the archive.
+ */
+template<class Format>
+bool parseArchiveImage(const byte *image, uint32 size, std::list<FileInfo> &files) {
+	typedef ArchiveLayout<Format> Layout;
+
+	if (size < Layout::kHeaderSize)
+		return false;
+
+	if (Format::kHasSizeField && (Layout::Order::read32(image) != size))
+		return false;
+
+	const uint32 count = Layout::readCount(image);
+	if ((Layout::kHeaderSize + (uint64) count * Layout::kEntrySize) > size)
+		return false;
+
+	parseFileList<Format>(image + Layout::kHeaderSize, count, files);
+
+	// Relative offsets that wrapped around end up before the data
+	const uint32 dataStart = Format::kRelativeOffsets ? Layout::getDataStart(count) : 0;
+
+	for (std::list<FileInfo>::const_iterator f = files.begin(); f != files.end(); ++f)
+		if ((f->offset < dataStart) || (((uint64) f->offset + f->size) > size))
+			return false;
+
+	return true;
+}
+
+/** Convert a file name into the name of a directory entry.
+ *
+ *  The implicit suffix is stripped, and the rest has to fit the entry.
+ */
+template<class Format>
+bool makeEntryName(const std::string &fileName, char *name) {
+	std::string entryName = fileName;
+
+	const char  *suffix       = Format::getNameSuffix();
+	const size_t suffixLength = strlen(suffix);
+
+	if (suffixLength > 0) {
+		if ((entryName.size() > suffixLength) &&
+		    !strcasecmp(entryName.c_str() + entryName.size() - suffixLength, suffix))
+			entryName.resize(entryName.size() - suffixLength);
+
+		// The suffix is the only extension such a name can have
+		if (entryName.find('.') != std::string::npos)
+			return false;
+	}
+
+	if (entryName.empty() || (entryName.size() > Format::kNameLength))
+		return false;
+
+	strcpy(name, entryName.c_str());
+	return true;
+}
+
+/** Build the header and directory of an archive holding these files.
+ *
+ *  The files' data is laid out consecutively after the directory, in order.
+ *  The offsets of the passed files are filled in as absolute offsets.
+ *
+ *  @return The header and directory, to be deleted by the caller, or 0 if the archive would be too big.
+ */
+template<class Format>
+byte *buildArchiveDirectory(std::list<FileInfo> &files, uint32 &dirSize) {
+	typedef ArchiveLayout<Format> Layout;
+
+	if (Layout::getDataStart(files.size()) >= 0xFFFFFFFFULL)
+		return 0;
+
+	const uint32 count     = files.size();
+	const uint32 dataStart = Layout::getDataStart(count);
+
+	dirSize = dataStart;
+
+	byte *dir = new byte[dirSize];
+	memset(dir, 0, dirSize);
+
+	Layout::writeCount(dir, count);
+
+	uint64 offset = dataStart;
+
+	byte *entry = dir + Layout::kHeaderSize;
+	for (std::list<FileInfo>::iterator f = files.begin(); f != files.end(); ++f, entry += Layout::kEntrySize) {
+		memcpy(entry, f->name, MIN<size_t>(strlen(f->name), Format::kNameLength));
+
+		f->offset = offset;
+
+		Layout::Order::write32(entry + Format::kNameLength    , f->size);
+		Layout::Order::write32(entry + Format::kNameLength + 4, offset - (Format::kRelativeOffsets ? dataStart : 0));
+
+		offset += f->size;
+	}
+
+	if (offset >= 0xFFFFFFFFULL) {
+		delete[] dir;
+		return 0;
+	}
+
+	if (Format::kHasSizeField)
+		Layout::Order::write32(dir, offset);
+
+	return dir;
+}
+
+/** Find the directory entry of a file, by its name from makeEntryName().
+ *
+ *  @param  dir   The header and directory of the archive.
+ *  @param  name  The name of the entry, compared case-insensitively.
+ *  @param  index Set to the index of the entry.
+ */
+template<class Format>
+bool findArchiveEntry(const byte *dir, const char *name, uint32 &index) {
+	typedef ArchiveLayout<Format> Layout;
+
+	const uint32 count = Layout::readCount(dir);
+
+	const byte *entry = dir + Layout::kHeaderSize;
+	for (index = 0; index < count; index++, entry += Layout::kEntrySize)
+		if (!strncasecmp((const char *) entry, name, Format::kNameLength))
+			return true;
+
+	return false;
+}
+
+/** Change the directory of an archive to give a file new data of a different size.
+ *
+ *  If the new data fits before the data of the next file, it replaces the
+ *  old data in place. Otherwise, it goes to the end of the archive. Only
+ *  the file's directory entry and, if the format has one, the size field
+ *  are changed.
+ *
+ *  @param  dir         The header and directory of the archive, changed in place.
+ *  @param  archiveSize The current size of the archive.
+ *  @param  index       The index of the file's directory entry.
+ *  @param  size        The size of the new data.
+ *  @param  offset      Set to the absolute offset the new data goes to.
+ *  @param  inPlace     Set to true if the new data replaces the old data.
+ *  @return false if the archive would be too big.
+ */
+template<class Format>
+bool updateArchiveDirectory(byte *dir, uint32 archiveSize, uint32 index, uint32 size, uint32 &offset, bool &inPlace) {
+	typedef ArchiveLayout<Format> Layout;
+
+	const uint32 count      = Layout::readCount(dir);
+	const uint32 offsetBias = Format::kRelativeOffsets ? Layout::getDataStart(count) : 0;
+
+	byte *entries = dir + Layout::kHeaderSize + Format::kNameLength;
+
+	const uint64 oldOffset = (uint64) Layout::Order::read32(entries + index * Layout::kEntrySize + 4) + offsetBias;
+
+	// The file's space ends where the next file's data starts
+	uint64 slotEnd = 0xFFFFFFFFFFFFFFFFULL;
+	for (uint32 i = 0; i < count; i++) {
+		if ((i == index) || (Layout::Order::read32(entries + i * Layout::kEntrySize) == 0))
+			continue;
+
+		const uint64 fileOffset = (uint64) Layout::Order::read32(entries + i * Layout::kEntrySize + 4) + offsetBias;
+		if ((fileOffset >= oldOffset) && (fileOffset < slotEnd))
+			slotEnd = fileOffset;
+	}
+
+	// The last file can always grow at the end
+	inPlace = (oldOffset >= Layout::getDataStart(count)) && (size <= (slotEnd - oldOffset));
+
+	const uint64 newOffset = inPlace ? oldOffset : archiveSize;
+	const uint64 newSize   = MAX<uint64>(archiveSize, newOffset + size);
+
+	if (newSize > 0xFFFFFFFFULL)
+		return false;
+
+	offset = newOffset;
+
+	Layout::Order::write32(entries + index * Layout::kEntrySize    , size);
+	Layout::Order::write32(entries + index * Layout::kEntrySize + 4, offset - offsetBias);
+
+	if (Format::kHasSizeField)
+		Layout::Order::write32(dir, newSize);
+
+	return true;
+}
+
+} // End of namespace Common
+
+#endif // COMMON_ARCHIVE_H
@@ -0,0 +1,367 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/archivediff.cpp
+ *  Comparing two archives, and binary delta patches between them.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include <map>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+
+#include "common/util.h"
+#include "common/fileio.h"
+#include "common/glue.h"
+#include "common/delta.h"
+#include "common/trace.h"
+#include "common/archivediff.h"
+
+namespace Common {
+
+/** The buffer of an uncompressed glue has this much slack after the data. */
+static const uint32 kGlueSlack = 128;
+
+/** Reading an archive of unknown size, like from a pipe, grows the image by this much at a time. */
+static const uint32 kReadBlockSize = 1024 * 1024;
+
+ArchiveImage::ArchiveImage() : size(0) {
+}
+
+bool readArchiveImage(std::istream &archive, bool compressible, ArchiveImage &image) {
+	TraceSpan span("read archive");
+
+	if (compressible && isCompressedGlue(archive)) {
+		const uint32 size = getUncompressedGlueSize(archive);
+		if (size == 0)
+			return false;
+
+		image.data.resize(size);
+		if (!uncompressGlue(archive, &image.data[0], size))
+			return false;
+
+		image.size = size - kGlueSlack;
+
+		span.setBytes(image.size);
+		return true;
+	}
+
+	archive.clear();
+
+	uint32 size = getSize(archive);
+	if (size != 0xFFFFFFFF) {
+		image.data.resize(size);
+
+		archive.seekg(0, std::ios_base::beg);
+		if (size > 0)
+			archive.read((char *) &image.data[0], size);
+
+		image.size = archive.gcount();
+		if (image.size != size)
+			return false;
+
+		span.setBytes(image.size);
+		return true;
+	}
+
+	// Can't tell the size, read until the end
+	archive.clear();
+	archive.seekg(0, std::ios_base::beg);
+
+	for (size = 0; archive.good(); size += archive.gcount()) {
+		if ((0xFFFFFFFF - size) < kReadBlockSize)
+			return false;
+
+		image.data.resize(size + kReadBlockSize);
+
+		archive.read((char *) &image.data[size], kReadBlockSize);
+	}
+
+	image.data.resize(size);
+	image.size = size;
+
+	span.setBytes(image.size);
+	return true;
+}
+
+/** A file within an archive image, and the hash of its data. */
+struct MemberHash {
+	const FileInfo *file;
+	const byte *data;
+
+	uint64 hash;
+};
+
+static void hashMemberWorker(std::vector<MemberHash> *members, std::atomic<uint32> *next) {
+	uint32 i;
+	while ((i = next->fetch_add(1)) < members->size()) {
+		MemberHash &member = (*members)[i];
+
+		TraceSpan span("hash member", member.file->name);
+		span.setBytes(member.file->size);
+
+		member.hash = hashData64(member.data, member.file->size);
+	}
+}
+
+static void hashMemberThread(std::vector<MemberHash> *members, std::atomic<uint32> *next) {
+	setTraceThreadName("hasher");
+
+	hashMemberWorker(members, next);
+}
+
+/** Hash all files of an archive image, in parallel. */
+static void hashMembers(const ArchiveImage &image, std::vector<MemberHash> &members) {
+	members.reserve(image.files.size());
+	for (std::list<FileInfo>::const_iterator f = image.files.begin(); f != image.files.end(); ++f) {
+		MemberHash member;
+
+		member.file = &*f;
+		member.data = image.data.empty() ? 0 : &image.data[f->offset];
+		member.hash = 0;
+
+		members.push_back(member);
+	}
+
+	std::atomic<uint32> next(0);
+
+	// The calling thread hashes as well
+	const uint32 threadCount = MIN<uint32>(std::thread::hardware_concurrency(), members.size());
+
+	std::vector<std::thread> threads;
+	for (uint32 i = 1; i < threadCount; i++)
+		threads.push_back(std::thread(hashMemberThread, &members, &next));
+
+	hashMemberWorker(&members, &next);
+
+	for (std::vector<std::thread>::iterator t = threads.begin(); t != threads.end(); ++t)
+		t->join();
+}
+
+static bool isSameMember(const MemberHash &a, const MemberHash &b) {
+	return (a.file->size == b.file->size) && (a.hash == b.hash);
+}
+
+static bool compareMemberOffsets(const MemberHash *a, const MemberHash *b) {
+	return a->file->offset < b->file->offset;
+}
+
+/** Return how many bytes at the start of two blocks are the same. */
+static uint32 getCommonPrefix(const byte *a, const byte *b, uint32 size) {
+	uint32 n = 0;
+
+	while (((size - n) >= 64) && !memcmp(a + n, b + n, 64))
+		n += 64;
+	while ((n < size) && (a[n] == b[n]))
+		n++;
+
+	return n;
+}
+
+/** Return how many bytes at the end of two blocks are the same. */
+static uint32 getCommonSuffix(const byte *a, const byte *b, uint32 size) {
+	uint32 n = 0;
+
+	while (((size - n) >= 64) && !memcmp(a - n - 64, b - n - 64, 64))
+		n += 64;
+	while ((n < size) && (a[-1 - (int32) n] == b[-1 - (int32) n]))
+		n++;
+
+	return n;
+}
+
+/** Produce a changed file by copying what it shares with the old file at its start and end. */
+static void addChangedMember(Delta &delta, const MemberHash &oldMember, const MemberHash &newMember) {
+	const uint32 oldSize = oldMember.file->size;
+	const uint32 newSize = newMember.file->size;
+
+	const uint32 prefix = getCommonPrefix(oldMember.data, newMember.data, MIN(oldSize, newSize));
+	const uint32 suffix = getCommonSuffix(oldMember.data + oldSize, newMember.data + newSize,
+	                                      MIN(oldSize, newSize) - prefix);
+
+	delta.copy(oldMember.file->offset, prefix);
+	delta.add(newSize - prefix - suffix);
+	delta.copy(oldMember.file->offset + oldSize - suffix, suffix);
+}
+
+static bool writePatch(const ArchiveImage &oldImage, const ArchiveImage &newImage,
+                       const std::vector<MemberHash> &oldMembers, const std::vector<MemberHash> &newMembers,
+                       const std::vector<int32> &sameName, const std::string &patchFile) {
+
+	TraceSpan span("create patch");
+	span.setBytes(newImage.size);
+
+	// Any old file with the same data can be copied, even if it was moved or renamed
+	std::map<uint64, const MemberHash *> oldData;
+	for (std::vector<MemberHash>::const_iterator m = oldMembers.begin(); m != oldMembers.end(); ++m)
+		oldData.insert(std::make_pair(m->hash, &*m));
+
+	// Produce the new image front to back
+	std::vector<const MemberHash *> order;
+	for (std::vector<MemberHash>::const_iterator m = newMembers.begin(); m != newMembers.end(); ++m)
+		order.push_back(&*m);
+
+	std::stable_sort(order.begin(), order.end(), compareMemberOffsets);
+
+	Delta delta(oldImage.data.empty() ? 0 : &oldImage.data[0], oldImage.size,
+	            newImage.data.empty() ? 0 : &newImage.data[0], newImage.size);
+
+	for (std::vector<const MemberHash *>::const_iterator m = order.begin(); m != order.end(); ++m) {
+		const MemberHash &member = **m;
+
+		// Overlapping files are produced as a part of the file before them
+		if (member.file->offset < delta.getPosition())
+			continue;
+
+		// Header, directory and padding
+		delta.add(member.file->offset - delta.getPosition());
+
+		std::map<uint64, const MemberHash *>::const_iterator same = oldData.find(member.hash);
+		const int32 index = sameName[&member - &newMembers[0]];
+
+		if      ((same != oldData.end()) && isSameMember(*same->second, member))
+			delta.copy(same->second->file->offset, member.file->size);
+		else if (index >= 0)
+			addChangedMember(delta, oldMembers[index], member);
+		else
+			delta.add(member.file->size);
+	}
+
+	delta.add(newImage.size - delta.getPosition());
+
+	std::printf("Writing patch \"%s\"... ", patchFile.c_str());
+	std::fflush(stdout);
+
+	if (!delta.write(patchFile)) {
+		std::printf("FAILED\n");
+		return false;
+	}
+
+	std::printf("done (%u of %u bytes added)\n", delta.getAddedSize(), newImage.size);
+	return true;
+}
+
+bool diffArchives(const ArchiveImage &oldImage, const ArchiveImage &newImage, const std::string &patchFile) {
+	std::vector<MemberHash> oldMembers, newMembers;
+	{
+		TraceSpan span("hash members");
+		span.setBytes(oldImage.size + newImage.size);
+
+		hashMembers(oldImage, oldMembers);
+		hashMembers(newImage, newMembers);
+	}
+
+	// Files are matched by name, with duplicate names the first one counts
+	std::map<std::string, uint32> oldNames;
+	for (uint32 i = 0; i < oldMembers.size(); i++)
+		oldNames.insert(std::make_pair(std::string(oldMembers[i].file->name), i));
+
+	std::vector<bool>  oldFound(oldMembers.size(), false);
+	std::vector<int32> sameName(newMembers.size(), -1);
+
+	uint32 added = 0, removed = 0, changed = 0, unchanged = 0;
+
+	for (uint32 i = 0; i < newMembers.size(); i++) {
+		const MemberHash &member = newMembers[i];
+
+		std::map<std::string, uint32>::const_iterator old = oldNames.find(member.file->name);
+		if (old == oldNames.end()) {
+			std::printf("Added:   %s (%u bytes)\n", member.file->name, member.file->size);
+			added++;
+			continue;
+		}
+
+		oldFound[old->second] = true;
+		sameName[i] = old->second;
+
+		if (isSameMember(oldMembers[old->second], member)) {
+			unchanged++;
+			continue;
+		}
+
+		std::printf("Changed: %s (%u -> %u bytes)\n", member.file->name,
+		            oldMembers[old->second].file->size, member.file->size);
+		changed++;
+	}
+
+	for (uint32 i = 0; i < oldMembers.size(); i++) {
+		if (oldFound[i])
+			continue;
+
+		std::printf("Removed: %s (%u bytes)\n", oldMembers[i].file->name, oldMembers[i].file->size);
+		removed++;
+	}
+
+	std::printf("%u added, %u removed, %u changed, %u unchanged\n", added, removed, changed, unchanged);
+
+	if (patchFile.empty())
+		return true;
+
+	return writePatch(oldImage, newImage, oldMembers, newMembers, sameName, patchFile);
+}
+
+bool patchArchive(const ArchiveImage &oldImage, const std::vector<byte> &patch, const std::string &newFile) {
+	std::vector<byte> newImage;
+
+	bool valid;
+	{
+		TraceSpan span("apply patch");
+
+		valid = Delta::apply(patch.empty() ? 0 : &patch[0], patch.size(),
+		                     oldImage.data.empty() ? 0 : &oldImage.data[0], oldImage.size, newImage);
+
+		span.setBytes(newImage.size());
+	}
+
+	if (!valid) {
+		std::printf("The patch does not fit this archive\n");
+		return false;
+	}
+
+	std::printf("Writing \"%s\"... ", newFile.c_str());
+	std::fflush(stdout);
+
+	TraceSpan span("write archive");
+	span.setBytes(newImage.size());
+
+	int fd = openWrite(newFile);
+
+	bool success = (fd >= 0) && writeData(fd, newImage.empty() ? 0 : &newImage[0], newImage.size());
+
+	if (fd >= 0)
+		closeFile(fd);
+
+	std::printf(success ? "done\n" : "FAILED\n");
+	return success;
+}
+
+} // End of namespace Common
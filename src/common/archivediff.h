@@ -0,0 +1,81 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/archivediff.h
+ *  Comparing two archives, and binary delta patches between them.
+ */
+
+#ifndef COMMON_ARCHIVEDIFF_H
+#define COMMON_ARCHIVEDIFF_H
+
+#include <list>
+#include <vector>
+#include <string>
+#include <istream>
+
+#include "common/types.h"
+#include "common/archive.h"
+
+namespace Common {
+
+/** A whole archive in memory. */
+struct ArchiveImage {
+	std::vector<byte> data;
+	uint32 size; ///< The size of the image, without any slack of the buffer.
+
+	std::list<FileInfo> files;
+
+	ArchiveImage();
+};
+
+/** Read a whole archive into memory, uncompressing a compressed glue.
+ *
+ *  The directory is not parsed yet, that's left to parseArchiveImage().
+ */
+bool readArchiveImage(std::istream &archive, bool compressible, ArchiveImage &image);
+
+/** Compare two archives by the contents of their files, and print the differences.
+ *
+ *  @param  oldImage  The older archive.
+ *  @param  newImage  The newer archive.
+ *  @param  patchFile If not empty, write a patch turning the older archive into the newer one into this file.
+ */
+bool diffArchives(const ArchiveImage &oldImage, const ArchiveImage &newImage, const std::string &patchFile);
+
+/** Apply a patch from diffArchives() to an archive and write the result into a file.
+ *
+ *  @param  oldImage The archive the patch was made for.
+ *  @param  patch    The whole patch file.
+ *  @param  newFile  The file to write the patched archive into.
+ */
+bool patchArchive(const ArchiveImage &oldImage, const std::vector<byte> &patch, const std::string &newFile);
+
+} // End of namespace Common
+
+#endif // COMMON_ARCHIVEDIFF_H
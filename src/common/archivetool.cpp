@@ -0,0 +1,663 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/archivetool.cpp
+ *  The common frontend of all archive tools, specialized by archive format.
+ */
+
+#include <cstdlib>
+#include <cstring>
+
+#include <thread>
+
+#include "common/util.h"
+#include "common/version.h"
+#include "common/input.h"
+#include "common/memreadstream.h"
+#include "common/glue.h"
+#include "common/gluestats.h"
+#include "common/gluecache.h"
+#include "common/gluestream.h"
+#include "common/identify.h"
+#include "common/archivetool.h"
+
+namespace Common {
+
+const char *const PGFFormat::kName  = "PGF";
+const char *const TNDFormat::kName  = "TND";
+const char *const GlueFormat::kName = "Glue";
+
+/** Default size limit of the uncompressed glue cache, in MiB. */
+static const uint32 kDefaultCacheSize = 256;
+
+static const char *kCommandChar[kCommandMAX] = { "l", "x", "u", "d", "p", "a", "i", "c" };
+/** The number of files every command takes, -1 for one or more. */
+static const int kCommandFiles[kCommandMAX] = {  1 ,  1 ,  2 ,  2 ,  3 ,  1 , -1 ,  2  };
+
+/** Is the glue decoder analysis built in? */
+#ifdef ENABLE_GLUE_STATS
+static const bool kHaveGlueStats = true;
+#else
+static const bool kHaveGlueStats = false;
+#endif
+
+static uint32 getDefaultJobs() {
+	return MAX<uint32>(std::thread::hardware_concurrency(), 1);
+}
+
+ExtractorOptions::ExtractorOptions() : command(kCommandNone), sequential(false), cacheSize(kDefaultCacheSize), stats(false),
+	hugePages(false), maxMemory(0), outputDir("."), shards(0), execJobs(getDefaultJobs()), progress(kProgressFull) {
+}
+
+static void printHeader(FILE *stream, const char *formatName, const char *type) {
+	std::fprintf(stream, "Dark Seed II %s archive %s\n", formatName, type);
+	std::fprintf(stream, "\n");
+	std::fprintf(stream, "%s\n", DS2TOOLS_NAMEVERSION);
+	std::fprintf(stream, "Copyright (c) %s, %s\n", DS2TOOLS_COPYRIGHTYEAR, DS2TOOLS_COPYRIGHTAUTHOR);
+	std::fprintf(stream, "%s\n", DS2TOOLS_URL);
+	std::fprintf(stream, "\n");
+}
+
+static void printExtractorUsage(FILE *stream, const char *name, const char *formatName, bool compressible,
+                                bool updatable) {
+	printHeader(stream, formatName, "extractor");
+
+	std::fprintf(stream, "Usage: %s [<options>] <command> <file>\n", name);
+	if (updatable)
+		std::fprintf(stream, "       %s u <file> <new file>\n", name);
+	std::fprintf(stream, "       %s [--patch=<patch>] d <old file> <new file>\n", name);
+	std::fprintf(stream, "       %s p <old file> <patch> <new file>\n", name);
+	std::fprintf(stream, "       %s i <file> [<file> ...]\n", name);
+	std::fprintf(stream, "       %s c <file> <member>\n", name);
+	std::fprintf(stream, "\n");
+	std::fprintf(stream, "Options:\n");
+
+	if (compressible) {
+		std::fprintf(stream, "  --cache[=<dir>]       Keep uncompressed glues in a cache directory\n");
+		std::fprintf(stream, "                        (default: $XDG_CACHE_HOME/darkseed2-tools/glue)\n");
+		std::fprintf(stream, "  --cache-size=<MiB>    Size limit of the cache (default: %u MiB)\n", kDefaultCacheSize);
+		std::fprintf(stream, "  --stats               Print statistics about the extraction pipeline\n");
+		std::fprintf(stream, "  --huge-pages          Uncompress glues into transparent huge pages\n");
+		std::fprintf(stream, "  --max-memory=<MiB>    Uncompress bigger glues through a small window\n");
+	}
+
+	std::fprintf(stream, "  --progress=<mode>     What to print while extracting: quiet, summary, bar or\n");
+	std::fprintf(stream, "                        full, with a line for every file (default)\n");
+	std::fprintf(stream, "  --trace <file>        Write a timeline of the extraction as a Chrome trace\n");
+	std::fprintf(stream, "  --output <dir>        Extract into this directory (default: current directory)\n");
+	std::fprintf(stream, "  --shards=<n>          Spread the extracted files over n subdirectories, named\n");
+	std::fprintf(stream, "                        by two hex digits of a hash of the name (n <= %u)\n", OutputDirectory::kMaxShards);
+	std::fprintf(stream, "  --exec <command>      Run a shell command on every extracted file instead of\n");
+	std::fprintf(stream, "                        writing it: $1 is the file name, the data is on stdin\n");
+	std::fprintf(stream, "  --jobs=<n>            Run up to n commands at once (default: %u)\n", getDefaultJobs());
+	std::fprintf(stream, "  --patch <patch>       Write a patch from the old to the new file when comparing\n");
+	std::fprintf(stream, "\n");
+
+	std::fprintf(stream, "Commands:\n");
+	std::fprintf(stream, "  l          List archive contents\n");
+	std::fprintf(stream, "  x          Extract files to the output directory\n");
+	if (updatable)
+		std::fprintf(stream, "  u          Replace the file of the same name within the archive\n");
+	std::fprintf(stream, "  d          Compare the contents of two archives\n");
+	std::fprintf(stream, "  p          Apply a patch to an archive, writing the new archive\n");
+	if (compressible && kHaveGlueStats)
+		std::fprintf(stream, "  a          Analyze how a compressed glue decodes\n");
+	std::fprintf(stream, "  i          Identify the archive format of files, by their first few KiB\n");
+	std::fprintf(stream, "  c          Write a single file to stdout\n");
+}
+
+static void printCreatorUsage(FILE *stream, const char *name, const char *formatName) {
+	printHeader(stream, formatName, "creator");
+
+	std::fprintf(stream, "Usage: %s <archive> <file> [<file> ...]\n", name);
+}
+
+bool parseExtractorCommandLine(int argc, char **argv, const char *formatName, bool compressible, bool updatable,
+                               int &returnValue, ExtractorOptions &options) {
+
+	options = ExtractorOptions();
+
+	// No command, just display the help
+	if (argc == 1) {
+		printExtractorUsage(stdout, argv[0], formatName, compressible, updatable);
+		returnValue = 0;
+
+		return false;
+	}
+
+	// Options come before the command
+	int arg = 1;
+	for (; (arg < argc) && !strncmp(argv[arg], "--", 2); arg++) {
+		if        (compressible && !strcmp(argv[arg], "--cache")) {
+			options.cacheDir = GlueCache::getDefaultDirectory();
+			if (options.cacheDir.empty())
+				std::fprintf(stderr, "Note: Not caching, neither $XDG_CACHE_HOME nor $HOME are set\n");
+		} else if (compressible && !strncmp(argv[arg], "--cache=", 8)) {
+			options.cacheDir = argv[arg] + 8;
+		} else if (compressible && !strncmp(argv[arg], "--cache-size=", 13)) {
+			options.cacheSize = strtoul(argv[arg] + 13, 0, 10);
+		} else if (compressible && !strcmp(argv[arg], "--stats")) {
+			options.stats = true;
+		} else if (compressible && !strcmp(argv[arg], "--huge-pages")) {
+			options.hugePages = true;
+		} else if (compressible && !strncmp(argv[arg], "--max-memory=", 13)) {
+			options.maxMemory = strtoul(argv[arg] + 13, 0, 10);
+		} else if (!strncmp(argv[arg], "--progress=", 11) &&
+		           ProgressReporter::parseMode(argv[arg] + 11, options.progress)) {
+		} else if (!strcmp(argv[arg], "--trace") && ((arg + 1) < argc)) {
+			options.traceFile = argv[++arg];
+		} else if (!strncmp(argv[arg], "--trace=", 8)) {
+			options.traceFile = argv[arg] + 8;
+		} else if (!strcmp(argv[arg], "--output") && ((arg + 1) < argc)) {
+			options.outputDir = argv[++arg];
+		} else if (!strncmp(argv[arg], "--output=", 9)) {
+			options.outputDir = argv[arg] + 9;
+		} else if (!strncmp(argv[arg], "--shards=", 9)) {
+			options.shards = strtoul(argv[arg] + 9, 0, 10);
+		} else if (!strcmp(argv[arg], "--exec") && ((arg + 1) < argc)) {
+			options.execCommand = argv[++arg];
+		} else if (!strncmp(argv[arg], "--exec=", 7)) {
+			options.execCommand = argv[arg] + 7;
+		} else if (!strncmp(argv[arg], "--jobs=", 7)) {
+			options.execJobs = strtoul(argv[arg] + 7, 0, 10);
+		} else if (!strcmp(argv[arg], "--patch") && ((arg + 1) < argc)) {
+			options.patchFile = argv[++arg];
+		} else if (!strncmp(argv[arg], "--patch=", 8)) {
+			options.patchFile = argv[arg] + 8;
+		} else {
+			printExtractorUsage(stderr, argv[0], formatName, compressible, updatable);
+			returnValue = 1;
+
+			return false;
+		}
+	}
+
+	// Find out what we should do
+	if (arg < argc)
+		for (int i = 0; i < kCommandMAX; i++)
+			if (!strcmp(argv[arg], kCommandChar[i]))
+				options.command = (ArchiveCommand) i;
+
+	if ((options.command == kCommandUpdate) && !updatable)
+		options.command = kCommandNone;
+	if ((options.command == kCommandAnalyze) && !(compressible && kHaveGlueStats))
+		options.command = kCommandNone;
+
+	// Unknown command or wrong number of arguments, display the help
+	const int fileCount = argc - arg - 1;
+	if ((options.command == kCommandNone) ||
+	    ((kCommandFiles[options.command] < 0) ? (fileCount < 1) : (fileCount != kCommandFiles[options.command]))) {
+		printExtractorUsage(stderr, argv[0], formatName, compressible, updatable);
+		returnValue = 1;
+
+		return false;
+	}
+
+	// This is the file to use
+	options.file       = argv[arg + 1];
+	options.sequential = isSequentialInput(options.file);
+
+	for (int i = arg + 2; i < argc; i++)
+		options.extraFiles.push_back(argv[i]);
+
+	return true;
+}
+
+bool parseCreatorCommandLine(int argc, char **argv, const char *formatName,
+                             int &returnValue, std::string &archive, std::list<std::string> &paths) {
+
+	archive.clear();
+	paths.clear();
+
+	// No arguments, just display the help
+	if (argc == 1) {
+		printCreatorUsage(stdout, argv[0], formatName);
+		returnValue = 0;
+
+		return false;
+	}
+
+	// We need an archive and at least one file to put into it
+	if (argc < 3) {
+		printCreatorUsage(stderr, argv[0], formatName);
+		returnValue = 1;
+
+		return false;
+	}
+
+	archive = argv[1];
+	for (int i = 2; i < argc; i++)
+		paths.push_back(argv[i]);
+
+	return true;
+}
+
+std::istream *openArchive(const std::string &file) {
+	TraceSpan span("open archive", file.c_str());
+
+	std::istream *archive = openInputFile(file);
+	if (!archive)
+		std::printf("Error opening file \"%s\"\n", file.c_str());
+
+	return archive;
+}
+
+bool isCompressedArchive(std::istream &archive, bool compressible) {
+	if (!compressible)
+		return false;
+
+	TraceSpan span("compression probe");
+
+	return isCompressedGlue(archive);
+}
+
+std::istream *uncompressArchive(const ExtractorOptions &options, std::istream &archive, bool compressed) {
+	if (!compressed)
+		return &archive;
+
+	TraceSpan span("uncompress archive");
+
+	// If the file is compressed, uncompress it and operate on that
+	std::istream *stream = 0;
+	// The cache identifies glues by their path, which a pipe doesn't have
+	if (!options.cacheDir.empty() && !options.sequential) {
+		GlueCache cache(options.cacheDir, (uint64) options.cacheSize * 1024 * 1024);
+
+		stream = cache.uncompressGlue(options.file, archive);
+	} else
+		stream = uncompressGlue(archive);
+
+	if (!stream)
+		std::printf("Failed to uncompress the glue\n");
+
+	return stream;
+}
+
+bool exceedsMemoryBudget(const ExtractorOptions &options, std::istream &archive, bool compressed) {
+	if (!compressed || (options.maxMemory == 0))
+		return false;
+
+	return getUncompressedGlueSize(archive) > ((uint64) options.maxMemory * 1024 * 1024);
+}
+
+int streamCompressedArchive(const ExtractorOptions &options, std::istream &archive, const OutputDirectory &output) {
+	const bool extract = options.command == kCommandExtract;
+
+	CommandRunner *runner = extract ? createCommandRunner(options) : 0;
+	ProgressReporter progress(options.progress);
+
+	std::list<FileInfo> files;
+
+	int returnValue = streamCompressedGlue(archive, extract, runner, &output, progress, files) ? 0 : 3;
+	if (runner && !runner->finish() && (returnValue == 0))
+		returnValue = 3;
+
+	delete runner;
+	progress.finish();
+
+	if (returnValue != 0)
+		std::printf("Failed to uncompress the glue\n");
+	else if (!extract)
+		listFiles(files);
+
+	return returnValue;
+}
+
+int analyzeArchive(const ExtractorOptions &options) {
+#ifdef ENABLE_GLUE_STATS
+	std::istream *archive = openArchive(options.file);
+	if (!archive)
+		return 2;
+
+	int returnValue = 0;
+	if (!isCompressedGlue(*archive)) {
+		std::printf("Not a compressed glue\n");
+		returnValue = 3;
+	} else if (!analyzeGlue(*archive)) {
+		std::printf("Failed to uncompress the glue\n");
+		returnValue = 3;
+	}
+
+	delete archive;
+	return returnValue;
+#else
+	(void) options;
+
+	return 1;
+#endif
+}
+
+int identifyFiles(const ExtractorOptions &options) {
+	std::vector<std::string> files(1, options.file);
+	files.insert(files.end(), options.extraFiles.begin(), options.extraFiles.end());
+
+	int returnValue = 0;
+	for (std::vector<std::string>::const_iterator f = files.begin(); f != files.end(); ++f) {
+		ArchiveIdentity identity;
+
+		// Plain files take a single read, everything else goes through the generic input
+		if (!identifyArchiveFile(*f, identity)) {
+			std::istream *archive = openArchive(*f);
+			if (!archive) {
+				returnValue = 2;
+				continue;
+			}
+
+			identity = identifyArchive(*archive);
+			delete archive;
+		}
+
+		if (identity.type == kArchiveUnknown)
+			std::printf("%s: unknown\n", f->c_str());
+		else
+			std::printf("%s: %s archive, %u files (%s confidence)\n", f->c_str(),
+			            getArchiveTypeName(identity.type), identity.fileCount, getConfidenceName(identity.confidence));
+	}
+
+	return returnValue;
+}
+
+/** Write a part of a stream to a file. */
+static bool writeStreamData(int out, std::istream &stream, uint32 offset, uint32 size) {
+	stream.clear();
+	stream.seekg(offset, std::ios_base::beg);
+
+	std::vector<byte> buffer(MIN<uint32>(MAX<uint32>(size, 1), 64 * 1024));
+	while (size > 0) {
+		const uint32 toRead = MIN<uint32>(size, buffer.size());
+
+		stream.read((char *) &buffer[0], toRead);
+		if (((uint32) stream.gcount() != toRead) || !writeData(out, &buffer[0], toRead))
+			return false;
+
+		size -= toRead;
+	}
+
+	return true;
+}
+
+MemoryReadStream *uncompressCatImage(std::istream &glue) {
+	const uint32 size = getUncompressedGlueSize(glue);
+	if (size == 0)
+		return 0;
+
+	// Its pages might end up in a pipe, so it must never go back into the pool
+	byte *image = allocateBuffer(size);
+	if (!uncompressGlue(glue, image, size)) {
+		discardBuffer(image);
+		return 0;
+	}
+
+	return new MemoryReadStream(image, size, &discardBuffer);
+}
+
+int catFile(const ExtractorOptions &options, std::istream &stream, bool compressed, const std::list<FileInfo> &files) {
+	const std::string &name = options.extraFiles[0];
+
+	std::list<FileInfo>::const_iterator file = files.begin();
+	while ((file != files.end()) && strcasecmp(file->name, name.c_str()))
+		++file;
+
+	if (file == files.end()) {
+		std::fprintf(stderr, "No file \"%s\" in the archive\n", name.c_str());
+		return 3;
+	}
+
+	const uint64 end = (uint64) file->offset + file->size;
+
+	std::fflush(stdout);
+
+	bool success;
+	if (compressed) {
+		// The uncompressed glue is in memory, its pages can go into a pipe as they are
+		const MemoryReadStream &image = static_cast<const MemoryReadStream &>(stream);
+
+		success = (end <= image.getSize()) && sendMemory(1, image.getData() + file->offset, file->size);
+
+	} else {
+		// Straight from the archive file to stdout, without passing through user space
+		int fd = options.sequential ? -1 : openRead(options.file);
+		if (fd >= 0) {
+			success = (end <= getFileSize(fd)) && sendDataAt(1, fd, file->offset, file->size);
+
+			closeFile(fd);
+		} else
+			// Pipes and files within CD images can only be read through the stream
+			success = writeStreamData(1, stream, file->offset, file->size);
+	}
+
+	if (!success) {
+		std::fprintf(stderr, "Error writing \"%s\"\n", file->name);
+		return 3;
+	}
+
+	return 0;
+}
+
+bool usePipeline(const ExtractorOptions &options, bool compressed) {
+	// With the cache enabled, the whole uncompressed image is needed anyway
+	return compressed && (options.command == kCommandExtract) && (options.cacheDir.empty() || options.sequential);
+}
+
+void startExtractorTrace(const ExtractorOptions &options) {
+	if (options.traceFile.empty())
+		return;
+
+	startTrace();
+	setTraceThreadName("main");
+}
+
+int finishExtractorTrace(const ExtractorOptions &options, int returnValue) {
+	if (options.traceFile.empty())
+		return returnValue;
+
+	if (!finishTrace(options.traceFile)) {
+		std::printf("Error writing trace file \"%s\"\n", options.traceFile.c_str());
+
+		if (returnValue == 0)
+			returnValue = 2;
+	}
+
+	return returnValue;
+}
+
+bool openOutputDirectory(const ExtractorOptions &options, OutputDirectory &output) {
+	if (!output.open(options.outputDir, options.shards)) {
+		std::printf("Error opening output directory \"%s\"\n", options.outputDir.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+CommandRunner *createCommandRunner(const ExtractorOptions &options) {
+	if (options.execCommand.empty())
+		return 0;
+
+	return new CommandRunner(options.execCommand, options.execJobs);
+}
+
+static bool isBeforeInArchive(const FileInfo &a, const FileInfo &b) {
+	return a.offset < b.offset;
+}
+
+void sortFilesByOffset(std::list<FileInfo> &files) {
+	files.sort(isBeforeInArchive);
+}
+
+void listFiles(const std::list<FileInfo> &files) {
+	std::printf("Number of files: %u\n\n", (uint) files.size());
+
+	std::printf(" Filename    | Size\n");
+	std::printf("=============|===========\n");
+
+	for (std::list<FileInfo>::const_iterator f = files.begin(); f != files.end(); ++f)
+		std::printf("%12s | %10d\n", f->name, f->size);
+}
+
+void extractFiles(std::istream &archive, const std::list<FileInfo> &files, CommandRunner *runner,
+                  const OutputDirectory *output, ProgressReporter &progress) {
+
+	progress.start(files.size());
+
+	uint i = 0;
+	for (std::list<FileInfo>::const_iterator f = files.begin(); f != files.end(); ++f, ++i) {
+		TraceSpan span("write member", f->name);
+		span.setBytes(f->size);
+
+		bool success;
+		if (runner)
+			success = runner->run(f->name, archive, f->offset, f->size);
+		else
+			success = output->writeFile(f->name, archive, f->offset, f->size);
+
+		progress.reportFile(i, f->name, f->size, success);
+	}
+}
+
+std::string getFileBaseName(const std::string &path) {
+	std::string::size_type slash = path.find_last_of("/\\");
+
+	return (slash == std::string::npos) ? path : path.substr(slash + 1);
+}
+
+void printInvalidFileName(const std::string &name, const char *suffix) {
+	if (*suffix)
+		std::printf("Invalid file name \"%s\": needs to be a short name plus \"%s\"\n", name.c_str(), suffix);
+	else
+		std::printf("Invalid file name \"%s\": too long\n", name.c_str());
+}
+
+bool recoverArchive(const std::string &archive) {
+	bool recovered;
+	if (!FilePatch::recover(archive, recovered)) {
+		std::printf("Failed to finish an interrupted update of \"%s\"\n", archive.c_str());
+		return false;
+	}
+
+	if (recovered)
+		std::printf("Finished an interrupted update of \"%s\"\n", archive.c_str());
+
+	return true;
+}
+
+bool readWholeFile(const std::string &path, std::vector<byte> &data) {
+	int fd = openRead(path);
+	if (fd < 0) {
+		std::printf("Error opening file \"%s\"\n", path.c_str());
+		return false;
+	}
+
+	const uint32 size = getFileSize(fd);
+
+	bool success = size != 0xFFFFFFFF;
+	if (success) {
+		data.resize(size);
+
+		success = (size == 0) || readDataAt(fd, &data[0], size, 0);
+	}
+
+	closeFile(fd);
+
+	if (!success)
+		std::printf("Error reading file \"%s\"\n", path.c_str());
+
+	return success;
+}
+
+bool collectFiles(const std::list<std::string> &paths, std::list<FileInfo> &files,
+                  bool (*makeName)(const std::string &, char *), const char *suffix) {
+
+	for (std::list<std::string>::const_iterator p = paths.begin(); p != paths.end(); ++p) {
+		// Only the base name goes into the archive
+		const std::string name = getFileBaseName(*p);
+
+		FileInfo file;
+		if (!makeName(name, file.name)) {
+			printInvalidFileName(name, suffix);
+			return false;
+		}
+
+		int fd = openRead(*p);
+		if (fd < 0) {
+			std::printf("Error opening file \"%s\"\n", p->c_str());
+			return false;
+		}
+
+		file.size = getFileSize(fd);
+
+		closeFile(fd);
+
+		if (file.size == 0xFFFFFFFF) {
+			std::printf("Error reading file \"%s\"\n", p->c_str());
+			return false;
+		}
+
+		files.push_back(file);
+	}
+
+	return true;
+}
+
+bool writeArchive(int archive, const byte *dir, uint32 dirSize, const std::list<FileInfo> &files,
+                  const std::list<std::string> &paths, const char *suffix) {
+
+	if (!writeData(archive, dir, dirSize)) {
+		std::printf("Error writing the file list\n");
+		return false;
+	}
+
+	const uint fileCount = files.size();
+
+	std::printf("Number of files: %u\n\n", fileCount);
+
+	uint i = 1;
+	std::list<std::string>::const_iterator p = paths.begin();
+	for (std::list<FileInfo>::const_iterator f = files.begin(); f != files.end(); ++f, ++p, ++i) {
+		std::printf("Packing %u/%u: \"%s%s\"... ", i, fileCount, f->name, suffix);
+		std::fflush(stdout);
+
+		int fd = openRead(*p);
+
+		bool success = (fd >= 0) && copyData(archive, fd, f->size);
+
+		closeFile(fd);
+
+		if (!success) {
+			std::printf("FAILED\n");
+			return false;
+		}
+
+		std::printf("done\n");
+	}
+
+	return true;
+}
+
+} // End of namespace Common
@@ -0,0 +1,554 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/archivetool.h
+ *  The common frontend of all archive tools, specialized by archive format.
+ */
+
+#ifndef COMMON_ARCHIVETOOL_H
+#define COMMON_ARCHIVETOOL_H
+
+#include <cstdio>
+
+#include <list>
+#include <vector>
+#include <string>
+#include <istream>
+
+#include "common/types.h"
+#include "common/archive.h"
+#include "common/fileio.h"
+#include "common/input.h"
+#include "common/memreadstream.h"
+#include "common/glue.h"
+#include "common/gluepipeline.h"
+#include "common/commandrunner.h"
+#include "common/outputdir.h"
+#include "common/filepatch.h"
+#include "common/archivediff.h"
+#include "common/progress.h"
+#include "common/bufferpool.h"
+#include "common/trace.h"
+
+namespace Common {
+
+enum ArchiveCommand {
+	kCommandNone    = -1,
+	kCommandList        ,
+	kCommandExtract     ,
+	kCommandUpdate      ,
+	kCommandDiff        ,
+	kCommandPatch       ,
+	kCommandAnalyze     ,
+	kCommandIdentify    ,
+	kCommandCat         ,
+	kCommandMAX
+};
+
+/** Everything found on the command line of an archive extractor. */
+struct ExtractorOptions {
+	ArchiveCommand command;
+	std::string file;
+
+	bool sequential; ///< The file can only be read front to back, like stdin or a pipe.
+
+	/** The files the command works on besides the archive.
+	 *
+	 *  - kCommandUpdate:   The file to put into the archive.
+	 *  - kCommandDiff:     The newer archive.
+	 *  - kCommandPatch:    The patch, and the file to write the new archive into.
+	 *  - kCommandIdentify: More files to identify.
+	 *  - kCommandCat:      The name of the file to write to stdout.
+	 */
+	std::vector<std::string> extraFiles;
+
+	std::string cacheDir;  ///< Directory of the uncompressed glue cache, if enabled.
+	uint32      cacheSize; ///< Size limit of the glue cache, in MiB.
+
+	bool stats; ///< Print statistics about the extraction pipeline.
+
+	bool hugePages; ///< Back uncompressed glues by transparent huge pages.
+
+	uint32 maxMemory; ///< Uncompress glues bigger than this many MiB through a small window, if not 0.
+
+	std::string traceFile; ///< Write a Chrome trace of the extraction into this file, if set.
+
+	std::string outputDir; ///< Extract into this directory.
+	uint32      shards;    ///< Spread the extracted files over this many subdirectories, if not 0.
+
+	std::string execCommand; ///< Hand every extracted file to this command instead of writing it, if set.
+	uint32      execJobs;    ///< The most commands to run at the same time.
+
+	std::string patchFile; ///< Write a patch from the compared archives into this file, if set.
+
+	ProgressMode progress; ///< How much to report while extracting.
+
+	ExtractorOptions();
+};
+
+/** Parse the command line of an archive extractor.
+ *
+ *  @param  formatName   The name of the archive format.
+ *  @param  compressible Does the format support compressed archives?
+ *  @param  updatable    Can files be replaced within archives of this format?
+ */
+bool parseExtractorCommandLine(int argc, char **argv, const char *formatName, bool compressible, bool updatable,
+                               int &returnValue, ExtractorOptions &options);
+
+/** Parse the command line of an archive creator. */
+bool parseCreatorCommandLine(int argc, char **argv, const char *formatName,
+                             int &returnValue, std::string &archive, std::list<std::string> &paths);
+
+/** Open an archive file. Returns 0 on failure. */
+std::istream *openArchive(const std::string &file);
+
+/** Is this archive compressed?
+ *
+ *  @param  archive      The opened archive file.
+ *  @param  compressible Does the format support compressed archives?
+ */
+bool isCompressedArchive(std::istream &archive, bool compressible);
+
+/** Uncompress an archive if necessary.
+ *
+ *  @param  options    The options of the extractor.
+ *  @param  archive    The opened archive file.
+ *  @param  compressed Is the archive compressed, as found by isCompressedArchive()?
+ *  @return The archive data, either the archive file itself or its uncompressed image, or 0 on failure.
+ */
+std::istream *uncompressArchive(const ExtractorOptions &options, std::istream &archive, bool compressed);
+
+/** Uncompress a compressed glue while analyzing the decoder, and print a report.
+ *
+ *  Only available in builds with --enable-glue-stats.
+ */
+int analyzeArchive(const ExtractorOptions &options);
+
+/** Print the archive format of every given file, whatever the format of the tool. */
+int identifyFiles(const ExtractorOptions &options);
+
+/** Uncompress a glue for catFile(), into memory that is unmapped instead of reused afterwards. */
+MemoryReadStream *uncompressCatImage(std::istream &glue);
+
+/** Write a single file within an archive to stdout.
+ *
+ *  @param  options    The options of the extractor.
+ *  @param  stream     The archive data, either the archive file itself or its uncompressed image.
+ *  @param  compressed Is stream the uncompressed image of a compressed glue?
+ *  @param  files      The files within the archive.
+ */
+int catFile(const ExtractorOptions &options, std::istream &stream, bool compressed, const std::list<FileInfo> &files);
+
+/** Would uncompressing this archive as a whole take more memory than allowed? */
+bool exceedsMemoryBudget(const ExtractorOptions &options, std::istream &archive, bool compressed);
+
+/** List or extract a compressed glue, uncompressing it through a small window. */
+int streamCompressedArchive(const ExtractorOptions &options, std::istream &archive, const OutputDirectory &output);
+
+/** Should this archive be extracted by the uncompression pipeline? */
+bool usePipeline(const ExtractorOptions &options, bool compressed);
+
+/** Start tracing, if requested. */
+void startExtractorTrace(const ExtractorOptions &options);
+/** Write the trace, if requested. Returns the updated return value of the extractor. */
+int finishExtractorTrace(const ExtractorOptions &options, int returnValue);
+
+/** Create the runner for the extraction command, if requested. Returns 0 otherwise. */
+CommandRunner *createCommandRunner(const ExtractorOptions &options);
+
+/** Open the directory to extract into. */
+bool openOutputDirectory(const ExtractorOptions &options, OutputDirectory &output);
+
+/** Sort files by where their data is within the archive. */
+void sortFilesByOffset(std::list<FileInfo> &files);
+
+void listFiles(const std::list<FileInfo> &files);
+/** Extract files into the output directory, or hand them to a command runner if given. */
+void extractFiles(std::istream &archive, const std::list<FileInfo> &files, CommandRunner *runner,
+                  const OutputDirectory *output, ProgressReporter &progress);
+
+/** Return the file name part of a path. */
+std::string getFileBaseName(const std::string &path);
+
+/** Print why a file name can't be used within an archive. */
+void printInvalidFileName(const std::string &name, const char *suffix);
+
+/** Finish an interrupted update of an archive, if there was one. */
+bool recoverArchive(const std::string &archive);
+
+/** Read a whole file into memory, like the file to put into an archive. */
+bool readWholeFile(const std::string &path, std::vector<byte> &data);
+
+/** Open every file to put into an archive and find its size. */
+bool collectFiles(const std::list<std::string> &paths, std::list<FileInfo> &files,
+                  bool (*makeName)(const std::string &, char *), const char *suffix);
+
+/** Write a full archive, with a directory from buildArchiveDirectory(). */
+bool writeArchive(int archive, const byte *dir, uint32 dirSize, const std::list<FileInfo> &files,
+                  const std::list<std::string> &paths, const char *suffix);
+
+/** Replace a file within an archive, crash-safely.
+ *
+ *  Only the file's data, its directory entry and the archive's size field
+ *  are written, so the cost depends on the size of the file alone.
+ */
+template<class Format>
+int updateArchive(const ExtractorOptions &options) {
+	typedef ArchiveLayout<Format> Layout;
+
+	if (!recoverArchive(options.file))
+		return 3;
+
+	const std::string fileName = getFileBaseName(options.extraFiles[0]);
+
+	char name[13];
+	if (!makeEntryName<Format>(fileName, name)) {
+		printInvalidFileName(fileName, Format::getNameSuffix());
+		return 2;
+	}
+
+	std::vector<byte> data;
+	if (!readWholeFile(options.extraFiles[0], data))
+		return 2;
+
+	int fd = openRead(options.file);
+	if (fd < 0) {
+		std::printf("Error opening file \"%s\"\n", options.file.c_str());
+		return 2;
+	}
+
+	// Read the header and the directory
+	const uint32 archiveSize = getFileSize(fd);
+
+	std::vector<byte> dir(Layout::kHeaderSize);
+
+	bool valid = (archiveSize != 0xFFFFFFFF) && readDataAt(fd, &dir[0], Layout::kHeaderSize, 0);
+	if (valid) {
+		const uint64 dirSize = Layout::kHeaderSize + (uint64) Layout::readCount(&dir[0]) * Layout::kEntrySize;
+
+		valid = (dirSize <= archiveSize) && (!Format::kHasSizeField || (Layout::Order::read32(&dir[0]) == archiveSize));
+		if (valid) {
+			dir.resize(dirSize);
+
+			valid = readDataAt(fd, &dir[Layout::kHeaderSize], dirSize - Layout::kHeaderSize, Layout::kHeaderSize);
+		}
+	}
+
+	closeFile(fd);
+
+	if (!valid) {
+		std::printf("Not a valid %s file\n", Format::kName);
+		return 3;
+	}
+
+	uint32 index;
+	if (!findArchiveEntry<Format>(&dir[0], name, index)) {
+		std::printf("No file \"%s\" in the archive\n", fileName.c_str());
+		return 3;
+	}
+
+	uint32 offset;
+	bool inPlace;
+	if (!updateArchiveDirectory<Format>(&dir[0], archiveSize, index, data.size(), offset, inPlace)) {
+		std::printf("The archive would grow too big\n");
+		return 3;
+	}
+
+	FilePatch patch;
+
+	const uint32 entry = Layout::kHeaderSize + index * Layout::kEntrySize + Format::kNameLength;
+
+	patch.add(offset, data.empty() ? 0 : &data[0], data.size());
+	patch.add(entry, &dir[entry], 8);
+	if (Format::kHasSizeField)
+		patch.add(0, &dir[0], 4);
+
+	std::printf("Replacing \"%s\" %s... ", fileName.c_str(), inPlace ? "in place" : "at the end of the archive");
+	std::fflush(stdout);
+
+	if (!patch.apply(options.file)) {
+		std::printf("FAILED\n");
+		return 3;
+	}
+
+	std::printf("done\n");
+	return 0;
+}
+
+/** Read a whole archive into memory and parse its directory. */
+template<class Format>
+int loadArchiveImage(const std::string &file, ArchiveImage &image) {
+	std::istream *archive = openArchive(file);
+	if (!archive)
+		return 2;
+
+	bool valid = readArchiveImage(*archive, Format::kCompressible, image);
+	if (valid) {
+		TraceSpan span("parse directory");
+
+		valid = parseArchiveImage<Format>(image.data.empty() ? 0 : &image.data[0], image.size, image.files);
+	}
+
+	delete archive;
+
+	if (!valid) {
+		std::printf("Not a valid %s file: \"%s\"\n", Format::kName, file.c_str());
+		return 3;
+	}
+
+	return 0;
+}
+
+/** Write a single file within an archive to stdout.
+ *
+ *  stdout only gets the file's data, all messages go to stderr.
+ */
+template<class Format>
+int catArchiveFile(const ExtractorOptions &options) {
+	std::istream *archive = openInputFile(options.file);
+	if (!archive) {
+		std::fprintf(stderr, "Error opening file \"%s\"\n", options.file.c_str());
+		return 2;
+	}
+
+	std::istream *stream = archive;
+	if (isCompressedArchive(*archive, Format::kCompressible) && !(stream = uncompressCatImage(*archive))) {
+		std::fprintf(stderr, "Failed to uncompress the glue\n");
+
+		delete archive;
+		return 3;
+	}
+
+	std::list<FileInfo> files;
+
+	int returnValue;
+	if (!readArchive<Format>(*stream, files)) {
+		std::fprintf(stderr, "Not a valid %s file\n", Format::kName);
+		returnValue = 3;
+	} else
+		returnValue = catFile(options, *stream, stream != archive, files);
+
+	if (stream != archive)
+		delete stream;
+	delete archive;
+
+	return returnValue;
+}
+
+/** Compare two archives, optionally writing a patch between them.
+ *
+ *  Both archives are held in memory, compressed glues uncompressed only
+ *  once, and the files are compared by their hashes.
+ */
+template<class Format>
+int diffArchiveFiles(const ExtractorOptions &options) {
+	ArchiveImage oldImage, newImage;
+
+	int returnValue;
+	if (((returnValue = loadArchiveImage<Format>(options.file         , oldImage)) != 0) ||
+	    ((returnValue = loadArchiveImage<Format>(options.extraFiles[0], newImage)) != 0))
+		return returnValue;
+
+	return diffArchives(oldImage, newImage, options.patchFile) ? 0 : 3;
+}
+
+/** Apply a patch from diffArchiveFiles() to an archive. */
+template<class Format>
+int patchArchiveFile(const ExtractorOptions &options) {
+	ArchiveImage oldImage;
+
+	int returnValue = loadArchiveImage<Format>(options.file, oldImage);
+	if (returnValue != 0)
+		return returnValue;
+
+	std::vector<byte> patch;
+	if (!readWholeFile(options.extraFiles[0], patch))
+		return 2;
+
+	return patchArchive(oldImage, patch, options.extraFiles[1]) ? 0 : 3;
+}
+
+/** Run an archive extractor for the given format. */
+template<class Format>
+int runExtractor(const ExtractorOptions &options) {
+	if (Format::kUpdatable && (options.command == kCommandUpdate))
+		return updateArchive<Format>(options);
+	if (options.command == kCommandDiff)
+		return diffArchiveFiles<Format>(options);
+	if (options.command == kCommandPatch)
+		return patchArchiveFile<Format>(options);
+	if (Format::kCompressible && (options.command == kCommandAnalyze))
+		return analyzeArchive(options);
+	if (options.command == kCommandIdentify)
+		return identifyFiles(options);
+	if (options.command == kCommandCat)
+		return catArchiveFile<Format>(options);
+
+	// Files going to a command aren't written anywhere
+	OutputDirectory output;
+	if ((options.command == kCommandExtract) && options.execCommand.empty() && !openOutputDirectory(options, output))
+		return 2;
+
+	std::istream *archive = openArchive(options.file);
+	if (!archive)
+		return 2;
+
+	const bool compressed = isCompressedArchive(*archive, Format::kCompressible);
+
+	// A glue too big for the memory limit never gets uncompressed as a whole
+	if (((options.command == kCommandList) || (options.command == kCommandExtract)) &&
+	    exceedsMemoryBudget(options, *archive, compressed)) {
+
+		int returnValue = streamCompressedArchive(options, *archive, output);
+
+		delete archive;
+		return returnValue;
+	}
+
+	// Extracting a compressed glue overlaps reading, uncompressing and writing
+	if (usePipeline(options, compressed)) {
+		CommandRunner *runner = createCommandRunner(options);
+		ProgressReporter progress(options.progress);
+
+		int returnValue = extractCompressedGlue(*archive, options.stats, runner, &output, progress) ? 0 : 3;
+		if (runner && !runner->finish() && (returnValue == 0))
+			returnValue = 3;
+
+		progress.finish();
+
+		delete runner;
+		delete archive;
+		return returnValue;
+	}
+
+	std::istream *stream = uncompressArchive(options, *archive, compressed);
+	if (!stream) {
+		delete archive;
+		return 3;
+	}
+
+	std::list<FileInfo> files;
+
+	bool valid;
+	{
+		TraceSpan span("parse directory");
+
+		valid = readArchive<Format>(*stream, files);
+		span.setBytes(ArchiveLayout<Format>::getDataStart(files.size()));
+	}
+
+	int returnValue;
+	if (!valid) {
+		std::printf("Not a valid %s file\n", Format::kName);
+		returnValue = 3;
+	} else {
+		returnValue = 0;
+
+		if      (options.command == kCommandList)
+			listFiles(files);
+		else if (options.command == kCommandExtract) {
+			// Reading front to back, the files have to come in the order of their data
+			if (options.sequential && (stream == archive))
+				sortFilesByOffset(files);
+
+			CommandRunner *runner = createCommandRunner(options);
+			ProgressReporter progress(options.progress);
+
+			extractFiles(*stream, files, runner, &output, progress);
+			if (runner && !runner->finish())
+				returnValue = 3;
+
+			progress.finish();
+
+			delete runner;
+		}
+	}
+
+	if (stream != archive)
+		delete stream;
+	delete archive;
+
+	return returnValue;
+}
+
+/** The main function of an archive extractor for the given format. */
+template<class Format>
+int extractorMain(int argc, char **argv) {
+	int returnValue;
+	ExtractorOptions options;
+	if (!parseExtractorCommandLine(argc, argv, Format::kName, Format::kCompressible, Format::kUpdatable,
+	                               returnValue, options))
+		return returnValue;
+
+	startExtractorTrace(options);
+	setBufferHugePages(options.hugePages);
+
+	returnValue = runExtractor<Format>(options);
+
+	return finishExtractorTrace(options, returnValue);
+}
+
+/** The main function of an archive creator for the given format. */
+template<class Format>
+int creatorMain(int argc, char **argv) {
+	int returnValue;
+	std::string archive;
+	std::list<std::string> paths;
+	if (!parseCreatorCommandLine(argc, argv, Format::kName, returnValue, archive, paths))
+		return returnValue;
+
+	std::list<FileInfo> files;
+	if (!collectFiles(paths, files, &makeEntryName<Format>, Format::getNameSuffix()))
+		return 2;
+
+	uint32 dirSize;
+	byte *dir = buildArchiveDirectory<Format>(files, dirSize);
+	if (!dir) {
+		std::printf("Archive would be too big\n");
+		return 3;
+	}
+
+	int fd = openWrite(archive);
+	if (fd < 0) {
+		std::printf("Error creating file \"%s\"\n", archive.c_str());
+		delete[] dir;
+		return 2;
+	}
+
+	bool success = writeArchive(fd, dir, dirSize, files, paths, Format::getNameSuffix());
+
+	closeFile(fd);
+	delete[] dir;
+
+	return success ? 0 : 3;
+}
+
+} // End of namespace Common
+
+#endif // COMMON_ARCHIVETOOL_H
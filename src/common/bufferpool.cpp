@@ -0,0 +1,182 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/bufferpool.cpp
+ *  Recycling large buffers, like uncompressed glue images, within a thread.
+ */
+
+#include <cstring>
+#include <new>
+#include <atomic>
+#include <vector>
+
+#include "common/util.h"
+#include "common/bufferpool.h"
+
+#ifdef HAVE_SYS_MMAN_H
+	#include <sys/mman.h>
+#endif
+
+namespace Common {
+
+/** Buffers are rounded up to a power of two, starting with this. */
+static const uint32 kMinBufferBits = 16;
+static const uint32 kBufferClasses = 32 - kMinBufferBits + 2;
+
+/** Each buffer is preceded by its size class, keeping the data aligned to cache lines. */
+static const uint32 kBufferHeaderSize = 64;
+
+/** Glue matches reach up to 4096 bytes back, so the data follows that many zeros. */
+static const uint32 kBufferLeadIn = 4096;
+
+/** A pool keeps at most this many bytes of released buffers; more are freed. */
+static const uint64 kMaxPoolSize = 64 * 1024 * 1024;
+
+/** Huge pages are only worth it for buffers at least this big. */
+static const uint64 kHugePageSize = 2 * 1024 * 1024;
+
+static std::atomic<bool> hugePages(false);
+
+static uint64 getClassSize(uint32 sizeClass) {
+	return 1ULL << (sizeClass + kMinBufferBits);
+}
+
+static void *mapBuffer(uint64 size) {
+#ifdef HAVE_SYS_MMAN_H
+	void *buffer = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buffer == MAP_FAILED)
+		return 0;
+
+	#ifdef MADV_HUGEPAGE
+	if (hugePages.load(std::memory_order_relaxed) && (size >= kHugePageSize))
+		madvise(buffer, size, MADV_HUGEPAGE);
+	#endif
+
+	return buffer;
+#else
+	return new byte[size];
+#endif
+}
+
+static void unmapBuffer(void *buffer, uint64 size) {
+#ifdef HAVE_SYS_MMAN_H
+	munmap(buffer, size);
+#else
+	delete[] (byte *) buffer;
+#endif
+}
+
+/** The released buffers of one thread. */
+struct BufferPool {
+	std::vector<byte *> buffers[kBufferClasses];
+	uint64 size;
+
+	BufferPoolStats stats;
+
+	BufferPool() : size(0) {
+	}
+
+	~BufferPool() {
+		for (uint32 i = 0; i < kBufferClasses; i++)
+			for (std::vector<byte *>::iterator b = buffers[i].begin(); b != buffers[i].end(); ++b)
+				unmapBuffer(*b, getClassSize(i));
+	}
+};
+
+static thread_local BufferPool bufferPool;
+
+byte *allocateBuffer(uint32 size) {
+	const uint64 fullSize = (uint64) size + kBufferHeaderSize + kBufferLeadIn;
+
+	uint32 sizeClass = 0;
+	while (getClassSize(sizeClass) < fullSize)
+		sizeClass++;
+
+	BufferPool &pool = bufferPool;
+
+	byte *buffer;
+	if (!pool.buffers[sizeClass].empty()) {
+		buffer = pool.buffers[sizeClass].back();
+		pool.buffers[sizeClass].pop_back();
+
+		pool.size -= getClassSize(sizeClass);
+		pool.stats.reuses++;
+
+	} else {
+		buffer = (byte *) mapBuffer(getClassSize(sizeClass));
+		if (!buffer)
+			throw std::bad_alloc();
+
+		pool.stats.allocations++;
+		pool.stats.allocated += getClassSize(sizeClass);
+	}
+
+	writeUint32LE(buffer, sizeClass);
+	memset(buffer + kBufferHeaderSize, 0, kBufferLeadIn);
+
+	return buffer + kBufferHeaderSize + kBufferLeadIn;
+}
+
+void releaseBuffer(byte *buffer) {
+	if (!buffer)
+		return;
+
+	buffer -= kBufferHeaderSize + kBufferLeadIn;
+
+	const uint32 sizeClass = readUint32LE(buffer);
+
+	BufferPool &pool = bufferPool;
+
+	if ((pool.size + getClassSize(sizeClass)) > kMaxPoolSize) {
+		unmapBuffer(buffer, getClassSize(sizeClass));
+		return;
+	}
+
+	pool.buffers[sizeClass].push_back(buffer);
+	pool.size += getClassSize(sizeClass);
+}
+
+void discardBuffer(byte *buffer) {
+	if (!buffer)
+		return;
+
+	buffer -= kBufferHeaderSize + kBufferLeadIn;
+
+	unmapBuffer(buffer, getClassSize(readUint32LE(buffer)));
+}
+
+void setBufferHugePages(bool enabled) {
+	hugePages.store(enabled, std::memory_order_relaxed);
+}
+
+BufferPoolStats getBufferPoolStats() {
+	return bufferPool.stats;
+}
+
+} // End of namespace Common
@@ -0,0 +1,79 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/bufferpool.h
+ *  Recycling large buffers, like uncompressed glue images, within a thread.
+ */
+
+#ifndef COMMON_BUFFERPOOL_H
+#define COMMON_BUFFERPOOL_H
+
+#include "common/types.h"
+
+namespace Common {
+
+/** Statistics about the calling thread's buffer pool. */
+struct BufferPoolStats {
+	uint64 allocations; ///< Buffers that had to be newly allocated.
+	uint64 reuses;      ///< Buffers that were handed out again from the pool.
+	uint64 allocated;   ///< Bytes newly allocated.
+
+	BufferPoolStats() : allocations(0), reuses(0), allocated(0) {
+	}
+};
+
+/** Get a buffer of at least this size.
+ *
+ *  Each thread keeps its own pool of released buffers, so that processing
+ *  one archive after the other reuses the same, already mapped memory
+ *  without taking any locks. The contents of the buffer are undefined, but
+ *  it is preceded by 4096 bytes of zeros: a glue chunk uncompressed to its
+ *  start reads zeros for matches that reach back before it.
+ */
+byte *allocateBuffer(uint32 size);
+
+/** Give a buffer from allocateBuffer() back, into the calling thread's pool. */
+void releaseBuffer(byte *buffer);
+
+/** Free a buffer from allocateBuffer() right away, instead of keeping it in the pool.
+ *
+ *  For buffers whose pages were handed to a pipe by sendMemory(): the pipe
+ *  keeps the pages, and unmapping them makes sure nothing writes to them again.
+ */
+void discardBuffer(byte *buffer);
+
+/** Back new buffers of at least 2 MiB by transparent huge pages, where the system supports it. */
+void setBufferHugePages(bool enabled);
+
+/** Return the statistics of the calling thread's pool. */
+BufferPoolStats getBufferPoolStats();
+
+} // End of namespace Common
+
+#endif // COMMON_BUFFERPOOL_H
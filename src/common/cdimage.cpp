@@ -0,0 +1,406 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/cdimage.cpp
+ *  Reading files straight out of ISO9660 CD images.
+ */
+
+#include <cstring>
+#include <strings.h>
+
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "common/util.h"
+#include "common/fileio.h"
+#include "common/cdimage.h"
+
+namespace Common {
+
+static const uint32 kRawSectorSize = 2352;
+
+/** The sync pattern at the start of each raw sector. */
+static const byte kSyncPattern[12] = { 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00 };
+
+/** The primary volume descriptor lives in sector 16. */
+static const uint32 kVolumeDescriptorSector = 16;
+
+CDImage::CDImage() : _fd(-1), _rawSectorSize(kSectorSize), _dataOffset(0), _sectorCount(0),
+	_rootSector(0), _rootSize(0) {
+}
+
+CDImage::~CDImage() {
+	close();
+}
+
+bool CDImage::open(const std::string &path) {
+	close();
+
+	if ((path.size() > 4) && !strcasecmp(path.c_str() + path.size() - 4, ".cue")) {
+		if (!openCue(path))
+			return false;
+	} else {
+		if ((_fd = openRead(path)) < 0)
+			return false;
+
+		if (!detectSectorSize()) {
+			close();
+			return false;
+		}
+	}
+
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	struct stat st;
+	if ((fstat(_fd, &st) != 0) || (st.st_size < 0)) {
+		close();
+		return false;
+	}
+
+	_sectorCount = MIN<uint64>((uint64) st.st_size / _rawSectorSize, 0xFFFFFFFF);
+
+	if (!readVolumeDescriptor()) {
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void CDImage::close() {
+	closeFile(_fd);
+
+	_fd = -1;
+
+	_rawSectorSize = kSectorSize;
+	_dataOffset    = 0;
+	_sectorCount   = 0;
+	_rootSector    = 0;
+	_rootSize      = 0;
+}
+
+bool CDImage::openCue(const std::string &path) {
+	std::ifstream cue(path.c_str());
+	if (!cue.is_open())
+		return false;
+
+	std::string::size_type slash = path.find_last_of("/\\");
+	const std::string dir = (slash == std::string::npos) ? "" : path.substr(0, slash + 1);
+
+	// We only care about the first file and its first track, which holds the file system
+	std::string line, binFile, mode;
+	while (std::getline(cue, line) && mode.empty()) {
+		std::string::size_type start = line.find_first_not_of(" \t");
+		if (start == std::string::npos)
+			continue;
+
+		if        (!line.compare(start, 5, "FILE ") && binFile.empty()) {
+			std::string::size_type quote1 = line.find('"', start);
+			std::string::size_type quote2 = line.find('"', quote1 + 1);
+
+			if ((quote1 == std::string::npos) || (quote2 == std::string::npos))
+				return false;
+
+			binFile = line.substr(quote1 + 1, quote2 - quote1 - 1);
+
+		} else if (!line.compare(start, 6, "TRACK ") && !binFile.empty()) {
+			std::string::size_type modeStart = line.find_last_of(" \t");
+
+			mode = line.substr(modeStart + 1);
+			mode.erase(mode.find_last_not_of("\r") + 1);
+		}
+	}
+
+	if (binFile.empty())
+		return false;
+
+	if      ((mode == "MODE1/2048") || (mode == "MODE2/2048"))
+		_rawSectorSize = kSectorSize, _dataOffset =  0;
+	else if  (mode == "MODE1/2352")
+		_rawSectorSize = kRawSectorSize, _dataOffset = 16;
+	else if  (mode == "MODE2/2352")
+		_rawSectorSize = kRawSectorSize, _dataOffset = 24;
+	else
+		return false;
+
+	if ((binFile[0] != '/') && ((_fd = openRead(dir + binFile)) >= 0))
+		return true;
+
+	return (_fd = openRead(binFile)) >= 0;
+}
+
+bool CDImage::detectSectorSize() {
+	byte sector[kRawSectorSize];
+
+	// Raw sectors start with a sync pattern and a header with the sector mode
+	const uint32 n = readAvailableAt(_fd, sector, kRawSectorSize, (uint64) kVolumeDescriptorSector * kRawSectorSize);
+	if ((n == kRawSectorSize) && !memcmp(sector, kSyncPattern, sizeof(kSyncPattern))) {
+		_rawSectorSize = kRawSectorSize;
+
+		if      (sector[15] == 1)
+			_dataOffset = 16;
+		else if (sector[15] == 2)
+			_dataOffset = 24; // Mode 2, form 1: there's an additional 8 byte subheader
+		else
+			return false;
+
+		return true;
+	}
+
+	_rawSectorSize = kSectorSize;
+	_dataOffset    = 0;
+
+	return true;
+}
+
+bool CDImage::readVolumeDescriptor() {
+	byte sector[kSectorSize];
+	if (readSectors(kVolumeDescriptorSector, 1, sector) != 1)
+		return false;
+
+	// Type 1, "CD001"
+	if ((sector[0] != 1) || memcmp(sector + 1, "CD001", 5))
+		return false;
+
+	// The directory record of the root directory
+	const byte *root = sector + 156;
+
+	_rootSector = readUint32LE(root +  2);
+	_rootSize   = readUint32LE(root + 10);
+
+	return true;
+}
+
+uint32 CDImage::readSectors(uint32 sector, uint32 count, byte *buffer) const {
+	if ((_fd < 0) || (sector >= _sectorCount))
+		return 0;
+
+	count = MIN(count, _sectorCount - sector);
+	if (((uint64) count * _rawSectorSize) > 0xFFFFFFFF)
+		return 0;
+
+	const uint64 start = (uint64) sector * _rawSectorSize;
+
+	if (_rawSectorSize == kSectorSize)
+		return readAvailableAt(_fd, buffer, count * kSectorSize, start) / kSectorSize;
+
+	// Read all raw sectors in one go, then strip the headers and error correction data
+	byte *raw = new byte[count * kRawSectorSize];
+
+	const uint32 read = readAvailableAt(_fd, raw, count * kRawSectorSize, start) / kRawSectorSize;
+	for (uint32 i = 0; i < read; i++)
+		memcpy(buffer + i * kSectorSize, raw + i * kRawSectorSize + _dataOffset, kSectorSize);
+
+	delete[] raw;
+	return read;
+}
+
+bool CDImage::findEntry(uint32 dirSector, uint32 dirSize, const std::string &name,
+                        uint32 &sector, uint32 &size, bool &isDir) const {
+
+	// The directory has to fit into the image, which also keeps the sizes here from overflowing
+	const uint64 sectorCount = ((uint64) dirSize + kSectorSize - 1) / kSectorSize;
+	if (((uint64) dirSector + sectorCount) > _sectorCount)
+		return false;
+
+	byte *dir = new byte[sectorCount * kSectorSize];
+	if (readSectors(dirSector, sectorCount, dir) != sectorCount) {
+		delete[] dir;
+		return false;
+	}
+
+	bool found = false;
+
+	uint64 pos = 0;
+	while (!found && (pos < dirSize)) {
+		const byte *record = dir + pos;
+		const uint8 length = record[0];
+
+		// Records never cross sector boundaries, the rest of this sector is padding
+		if (length == 0) {
+			pos = ((pos / kSectorSize) + 1) * kSectorSize;
+			continue;
+		}
+
+		if ((length < 34) || ((pos + length) > (sectorCount * kSectorSize)))
+			break;
+
+		const uint8 nameLength = record[32];
+
+		std::string entryName((const char *) record + 33, MIN<uint32>(nameLength, length - 33));
+
+		// Cut off the version number and a trailing dot of files without an extension
+		std::string::size_type semicolon = entryName.find(';');
+		if (semicolon != std::string::npos)
+			entryName.erase(semicolon);
+		if (!entryName.empty() && (entryName[entryName.size() - 1] == '.'))
+			entryName.erase(entryName.size() - 1);
+
+		if (!strcasecmp(entryName.c_str(), name.c_str())) {
+			sector = readUint32LE(record +  2);
+			size   = readUint32LE(record + 10);
+			isDir  = (record[25] & 0x02) != 0;
+
+			found = true;
+		}
+
+		pos += length;
+	}
+
+	delete[] dir;
+	return found;
+}
+
+bool CDImage::findFile(const std::string &path, uint32 &sector, uint32 &size) const {
+	if (_fd < 0)
+		return false;
+
+	sector = _rootSector;
+	size   = _rootSize;
+
+	bool isDir = true;
+
+	std::string::size_type start = 0;
+	while (start < path.size()) {
+		std::string::size_type slash = path.find_first_of("/\\", start);
+		if (slash == std::string::npos)
+			slash = path.size();
+
+		const std::string name = path.substr(start, slash - start);
+		start = slash + 1;
+
+		if (name.empty())
+			continue;
+
+		if (!isDir || !findEntry(sector, size, name, sector, size, isDir))
+			return false;
+	}
+
+	if (isDir)
+		return false;
+
+	return ((uint64) sector * kSectorSize + size) <= ((uint64) _sectorCount * kSectorSize);
+}
+
+
+CDFileStream::StreamBuf::StreamBuf(const CDImage &image, uint32 sector, uint32 size) :
+	_image(&image), _sector(sector), _size(size), _bufferStart(0) {
+
+	_buffer = new byte[kReadAhead * CDImage::kSectorSize];
+
+	setg((char *) _buffer, (char *) _buffer, (char *) _buffer);
+}
+
+CDFileStream::StreamBuf::~StreamBuf() {
+	delete[] _buffer;
+}
+
+bool CDFileStream::StreamBuf::fill(uint32 offset) {
+	if (offset >= _size)
+		return false;
+
+	// Always read whole, aligned sectors
+	const uint32 firstSector = offset / CDImage::kSectorSize;
+	const uint32 lastSector  = (_size - 1) / CDImage::kSectorSize;
+	const uint32 count       = MIN<uint32>(kReadAhead, lastSector - firstSector + 1);
+
+	const uint32 read = _image->readSectors(_sector + firstSector, count, _buffer);
+	if (read == 0)
+		return false;
+
+	_bufferStart = firstSector * CDImage::kSectorSize;
+
+	const uint32 available = MIN<uint32>(read * CDImage::kSectorSize, _size - _bufferStart);
+
+	setg((char *) _buffer, (char *) _buffer + (offset - _bufferStart), (char *) _buffer + available);
+	return true;
+}
+
+int CDFileStream::StreamBuf::underflow() {
+	if (gptr() < egptr())
+		return traits_type::to_int_type(*gptr());
+
+	if (!fill(_bufferStart + (egptr() - eback())))
+		return traits_type::eof();
+
+	return traits_type::to_int_type(*gptr());
+}
+
+std::streampos CDFileStream::StreamBuf::seekoff(std::streamoff off, std::ios_base::seekdir way,
+                                                std::ios_base::openmode which) {
+	if (!(which & std::ios_base::in))
+		return -1;
+
+	const int64 current = _bufferStart + (gptr() - eback());
+
+	int64 offset = 0;
+	if      (way == std::ios_base::beg)
+		offset = off;
+	else if (way == std::ios_base::cur)
+		offset = current + off;
+	else if (way == std::ios_base::end)
+		offset = _size + off;
+
+	if ((offset < 0) || (offset > _size))
+		return -1;
+
+	// Still within the buffer?
+	if ((offset >= _bufferStart) && (offset <= (_bufferStart + (egptr() - eback())))) {
+		setg(eback(), eback() + (offset - _bufferStart), egptr());
+		return offset;
+	}
+
+	// Otherwise, start with an empty buffer at the new position
+	_bufferStart = offset;
+	setg((char *) _buffer, (char *) _buffer, (char *) _buffer);
+
+	return offset;
+}
+
+std::streampos CDFileStream::StreamBuf::seekpos(std::streampos sp, std::ios_base::openmode which) {
+	return seekoff(sp, std::ios_base::beg, which);
+}
+
+
+CDFileStream::CDFileStream(const CDImage *image, uint32 sector, uint32 size, bool dispose) :
+	std::istream(_streamBuf = new StreamBuf(*image, sector, size)), _dispose(dispose), _image(image) {
+}
+
+CDFileStream::~CDFileStream() {
+	delete _streamBuf;
+
+	if (_dispose)
+		delete _image;
+}
+
+} // End of namespace Common
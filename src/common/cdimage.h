@@ -0,0 +1,129 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/cdimage.h
+ *  Reading files straight out of ISO9660 CD images.
+ */
+
+#ifndef COMMON_CDIMAGE_H
+#define COMMON_CDIMAGE_H
+
+#include <string>
+#include <istream>
+#include <streambuf>
+
+#include "common/types.h"
+
+namespace Common {
+
+/** An ISO9660 CD image.
+ *
+ *  Both plain images with 2048 byte sectors (.iso) and raw images with
+ *  2352 byte sectors (.bin, MODE1/2352 and MODE2/2352) are supported, as
+ *  well as .cue sheets pointing to the latter. The sector headers and error
+ *  correction data of raw images are stripped when reading.
+ */
+class CDImage {
+public:
+	CDImage();
+	~CDImage();
+
+	/** Open a CD image. */
+	bool open(const std::string &path);
+	void close();
+
+	/** Find a file in the image. The path components are matched case-insensitively.
+	 *  Files reaching past the end of the image aren't found. */
+	bool findFile(const std::string &path, uint32 &sector, uint32 &size) const;
+
+	/** Read a number of consecutive sectors into a buffer of count * 2048 bytes.
+	 *  Returns the number of sectors read, stopping at the end of the image. */
+	uint32 readSectors(uint32 sector, uint32 count, byte *buffer) const;
+
+	static const uint32 kSectorSize = 2048;
+
+private:
+	int _fd;
+
+	uint32 _rawSectorSize; ///< Size of a sector within the image file.
+	uint32 _dataOffset;    ///< Offset of the user data within a raw sector.
+	uint32 _sectorCount;   ///< Number of whole sectors in the image file.
+
+	uint32 _rootSector;
+	uint32 _rootSize;
+
+	bool openCue(const std::string &path);
+	bool detectSectorSize();
+	bool readVolumeDescriptor();
+
+	bool findEntry(uint32 dirSector, uint32 dirSize, const std::string &name,
+	               uint32 &sector, uint32 &size, bool &isDir) const;
+};
+
+/** A stream reading a contiguous file out of a CD image, with read-ahead. */
+class CDFileStream : public std::istream {
+private:
+	class StreamBuf : public std::streambuf {
+	public:
+		StreamBuf(const CDImage &image, uint32 sector, uint32 size);
+		~StreamBuf();
+
+		std::streampos seekoff(std::streamoff off, std::ios_base::seekdir way, std::ios_base::openmode which);
+		std::streampos seekpos(std::streampos sp, std::ios_base::openmode which);
+
+	protected:
+		int underflow();
+
+	private:
+		/** Number of sectors read at once. */
+		static const uint32 kReadAhead = 32;
+
+		const CDImage *_image;
+
+		uint32 _sector;
+		uint32 _size;
+
+		byte  *_buffer;
+		uint32 _bufferStart; ///< Offset within the file of the first byte in the buffer.
+
+		bool fill(uint32 offset);
+	};
+
+	bool _dispose;
+	const CDImage *_image;
+	StreamBuf *_streamBuf;
+
+public:
+	CDFileStream(const CDImage *image, uint32 sector, uint32 size, bool dispose = false);
+	~CDFileStream();
+};
+
+} // End of namespace Common
+
+#endif // COMMON_CDIMAGE_H
@@ -0,0 +1,188 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/commandrunner.cpp
+ *  Handing extracted files to an external command, without temporary files.
+ */
+
+#include <cerrno>
+#include <cstdio>
+
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "common/util.h"
+#include "common/fileio.h"
+#include "common/commandrunner.h"
+
+#ifdef UNIX
+	#include <sys/wait.h>
+#endif
+
+namespace Common {
+
+/** Size of the buffer used to copy files out of streams. */
+static const uint32 kStreamBufferSize = 64 * 1024;
+
+CommandRunner::CommandRunner(const std::string &command, uint32 maxJobs) :
+	_command(command), _maxJobs(MAX<uint32>(maxJobs, 1)), _failed(false) {
+}
+
+CommandRunner::~CommandRunner() {
+	finish();
+}
+
+bool CommandRunner::run(const char *name, const byte *data, uint32 size) {
+	int fd = createMemoryFile(name);
+	if (fd < 0)
+		return false;
+
+	if (!writeData(fd, data, size)) {
+		closeFile(fd);
+		return false;
+	}
+
+	return start(name, fd);
+}
+
+bool CommandRunner::run(const char *name, std::istream &stream, uint32 offset, uint32 size) {
+	int fd = createMemoryFile(name);
+	if (fd < 0)
+		return false;
+
+	stream.clear();
+	stream.seekg(offset, std::ios_base::beg);
+
+	std::vector<byte> buffer(MIN(size, kStreamBufferSize) + 1);
+
+	while (size > 0) {
+		const uint32 n = MIN(size, kStreamBufferSize);
+
+		stream.read((char *) &buffer[0], n);
+		if (((uint32) stream.gcount() != n) || !writeData(fd, &buffer[0], n)) {
+			closeFile(fd);
+			return false;
+		}
+
+		size -= n;
+	}
+
+	return start(name, fd);
+}
+
+bool CommandRunner::start(const char *name, int fd) {
+#ifndef UNIX
+	// No fork() here
+	(void) name;
+
+	closeFile(fd);
+	return false;
+#else
+	while (_jobs.size() >= _maxJobs)
+		wait();
+
+	// Only the command itself should see the file
+	if ((lseek(fd, 0, SEEK_SET) != 0) || (fcntl(fd, F_SETFD, FD_CLOEXEC) != 0)) {
+		closeFile(fd);
+		return false;
+	}
+
+	// Everything the child needs is prepared before forking
+	const char *argv[] = { "sh", "-c", _command.c_str(), "sh", name, 0 };
+
+	std::fflush(stdout);
+	std::fflush(stderr);
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		if (dup2(fd, 0) == 0)
+			execv("/bin/sh", (char * const *) argv);
+
+		_exit(127);
+	}
+
+	closeFile(fd);
+
+	if (pid < 0)
+		return false;
+
+	Job job;
+
+	job.pid  = pid;
+	job.name = name;
+
+	_jobs.push_back(job);
+	return true;
+#endif
+}
+
+void CommandRunner::wait() {
+#ifndef UNIX
+	_jobs.clear();
+#else
+	int status;
+
+	pid_t pid = waitpid(-1, &status, 0);
+	if (pid < 0) {
+		// No children left we know nothing about
+		if (errno == ECHILD)
+			_jobs.clear();
+
+		return;
+	}
+
+	for (std::list<Job>::iterator j = _jobs.begin(); j != _jobs.end(); ++j) {
+		if (j->pid != pid)
+			continue;
+
+		if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+			if (WIFEXITED(status))
+				std::printf("Command failed on \"%s\" (exit status %d)\n", j->name.c_str(), WEXITSTATUS(status));
+			else
+				std::printf("Command failed on \"%s\" (killed by signal %d)\n", j->name.c_str(), WTERMSIG(status));
+
+			_failed = true;
+		}
+
+		_jobs.erase(j);
+		break;
+	}
+#endif
+}
+
+bool CommandRunner::finish() {
+	while (!_jobs.empty())
+		wait();
+
+	return !_failed;
+}
+
+} // End of namespace Common
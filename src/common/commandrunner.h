@@ -0,0 +1,98 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/commandrunner.h
+ *  Handing extracted files to an external command, without temporary files.
+ */
+
+#ifndef COMMON_COMMANDRUNNER_H
+#define COMMON_COMMANDRUNNER_H
+
+#include <string>
+#include <list>
+#include <istream>
+
+#include <sys/types.h>
+
+#include "common/types.h"
+
+namespace Common {
+
+/** Run a shell command on each extracted file, several at once.
+ *
+ *  The file data is put into an anonymous memory file, which becomes the
+ *  standard input of the command. Since it's a real, seekable file, the
+ *  command can also open /dev/stdin. The command is run by /bin/sh, with
+ *  the name of the file as $1.
+ *
+ *  All methods have to be called from the same thread.
+ */
+class CommandRunner {
+public:
+	/** @param command The shell command to run.
+	 *  @param maxJobs The most commands to run at the same time.
+	 */
+	CommandRunner(const std::string &command, uint32 maxJobs);
+	~CommandRunner();
+
+	/** Start the command on a file held in memory.
+	 *
+	 *  Blocks while the maximum number of commands is running.
+	 *  Returns false if the command could not be started.
+	 */
+	bool run(const char *name, const byte *data, uint32 size);
+
+	/** Start the command on a file within a stream. */
+	bool run(const char *name, std::istream &stream, uint32 offset, uint32 size);
+
+	/** Wait for all commands to finish. Returns false if any failed. */
+	bool finish();
+
+private:
+	struct Job {
+		pid_t pid;
+		std::string name;
+	};
+
+	std::string _command;
+	uint32 _maxJobs;
+
+	std::list<Job> _jobs;
+
+	bool _failed;
+
+	bool start(const char *name, int fd);
+
+	/** Wait for one command to finish. */
+	void wait();
+};
+
+} // End of namespace Common
+
+#endif // COMMON_COMMANDRUNNER_H
@@ -0,0 +1,235 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/delta.cpp
+ *  Binary delta patches between two archive images.
+ */
+
+#include <cstring>
+
+#include "common/util.h"
+#include "common/fileio.h"
+#include "common/delta.h"
+
+namespace Common {
+
+/** The patch starts with the magic, the sizes and hashes of both images, and the number of operations. */
+static const char   kDeltaMagic[8]   = { 'D', 'S', '2', 'D', 'E', 'L', 'T', 'A' };
+static const uint32 kDeltaHeaderSize = 36;
+
+/** Copying is followed by the offset within the old image and the size. */
+static const byte   kOpCopy     = 0;
+static const uint32 kOpCopySize = 9;
+
+/** Adding is followed by the size and the data. */
+static const byte   kOpAdd     = 1;
+static const uint32 kOpAddSize = 5;
+
+static void writeHash(byte *data, uint64 hash) {
+	writeUint32LE(data    , (uint32) (hash & 0xFFFFFFFF));
+	writeUint32LE(data + 4, (uint32) (hash >> 32));
+}
+
+static uint64 readHash(const byte *data) {
+	return ((uint64) readUint32LE(data + 4) << 32) | readUint32LE(data);
+}
+
+Delta::Delta(const byte *oldImage, uint32 oldSize, const byte *newImage, uint32 newSize) :
+	_newImage(newImage), _newSize(newSize), _position(0), _addedSize(0), _lastOp(0), _patch(kDeltaHeaderSize) {
+
+	memcpy(&_patch[0], kDeltaMagic, 8);
+
+	writeUint32LE(&_patch[ 8], oldSize);
+	writeUint32LE(&_patch[12], newSize);
+
+	writeHash(&_patch[16], hashData64(oldImage, oldSize));
+	writeHash(&_patch[24], hashData64(newImage, newSize));
+
+	writeUint32LE(&_patch[32], 0);
+}
+
+Delta::~Delta() {
+}
+
+uint32 Delta::getPosition() const {
+	return _position;
+}
+
+uint32 Delta::getAddedSize() const {
+	return _addedSize;
+}
+
+void Delta::copy(uint32 oldOffset, uint32 size) {
+	if (size == 0)
+		return;
+
+	_position += size;
+
+	// Continuing the last copy
+	if ((_lastOp != 0) && (_patch[_lastOp] == kOpCopy)) {
+		const uint32 lastOffset = readUint32LE(&_patch[_lastOp + 1]);
+		const uint32 lastSize   = readUint32LE(&_patch[_lastOp + 5]);
+
+		if ((lastOffset + lastSize) == oldOffset) {
+			writeUint32LE(&_patch[_lastOp + 5], lastSize + size);
+			return;
+		}
+	}
+
+	_lastOp = _patch.size();
+	_patch.resize(_lastOp + kOpCopySize);
+
+	_patch[_lastOp] = kOpCopy;
+	writeUint32LE(&_patch[_lastOp + 1], oldOffset);
+	writeUint32LE(&_patch[_lastOp + 5], size);
+
+	writeUint32LE(&_patch[32], readUint32LE(&_patch[32]) + 1);
+}
+
+void Delta::add(uint32 size) {
+	if (size == 0)
+		return;
+
+	const byte *data = _newImage + _position;
+
+	_position  += size;
+	_addedSize += size;
+
+	// Continuing the last add, whose data is at the end of the patch
+	if ((_lastOp != 0) && (_patch[_lastOp] == kOpAdd)) {
+		writeUint32LE(&_patch[_lastOp + 1], readUint32LE(&_patch[_lastOp + 1]) + size);
+
+		_patch.insert(_patch.end(), data, data + size);
+		return;
+	}
+
+	_lastOp = _patch.size();
+	_patch.resize(_lastOp + kOpAddSize);
+
+	_patch[_lastOp] = kOpAdd;
+	writeUint32LE(&_patch[_lastOp + 1], size);
+
+	_patch.insert(_patch.end(), data, data + size);
+
+	writeUint32LE(&_patch[32], readUint32LE(&_patch[32]) + 1);
+}
+
+bool Delta::write(const std::string &file) const {
+	if (_position != _newSize)
+		return false;
+
+	int fd = openWrite(file);
+	if (fd < 0)
+		return false;
+
+	const bool success = writeData(fd, &_patch[0], _patch.size());
+
+	closeFile(fd);
+	return success;
+}
+
+/** Go through the operations of a patch, carrying them out if there's an output buffer.
+ *
+ *  Fails unless the operations produce exactly newSize bytes, out of the
+ *  old image and the patch, and end with the patch.
+ */
+static bool runPatch(const byte *patch, uint32 patchSize, const byte *oldImage, uint32 oldSize,
+                     byte *out, uint32 newSize) {
+
+	const uint32 count = readUint32LE(patch + 32);
+
+	uint32 position = 0;
+	uint32 patchPos = kDeltaHeaderSize;
+	for (uint32 i = 0; i < count; i++) {
+		if (patchPos >= patchSize)
+			return false;
+
+		const byte op = patch[patchPos];
+
+		if        ((op == kOpCopy) && ((patchSize - patchPos) >= kOpCopySize)) {
+			const uint32 offset = readUint32LE(patch + patchPos + 1);
+			const uint32 size   = readUint32LE(patch + patchPos + 5);
+
+			if ((offset > oldSize) || (size > (oldSize - offset)) || (size > (newSize - position)))
+				return false;
+
+			if (out)
+				memcpy(out + position, oldImage + offset, size);
+
+			position += size;
+			patchPos += kOpCopySize;
+
+		} else if ((op == kOpAdd) && ((patchSize - patchPos) >= kOpAddSize)) {
+			const uint32 size = readUint32LE(patch + patchPos + 1);
+
+			patchPos += kOpAddSize;
+
+			if ((size > (patchSize - patchPos)) || (size > (newSize - position)))
+				return false;
+
+			if (out)
+				memcpy(out + position, patch + patchPos, size);
+
+			position += size;
+			patchPos += size;
+
+		} else
+			return false;
+	}
+
+	return (position == newSize) && (patchPos == patchSize);
+}
+
+bool Delta::apply(const byte *patch, uint32 patchSize, const byte *oldImage, uint32 oldSize,
+                  std::vector<byte> &newImage) {
+
+	if ((patchSize < kDeltaHeaderSize) || memcmp(patch, kDeltaMagic, 8))
+		return false;
+
+	// Made for this image?
+	if ((readUint32LE(patch + 8) != oldSize) || (readHash(patch + 16) != hashData64(oldImage, oldSize)))
+		return false;
+
+	const uint32 newSize = readUint32LE(patch + 12);
+
+	// Check the operations first, so that a broken patch can't make us allocate a size it never produces
+	if (!runPatch(patch, patchSize, oldImage, oldSize, 0, newSize))
+		return false;
+
+	newImage.resize(newSize);
+
+	byte *out = newImage.empty() ? 0 : &newImage[0];
+
+	runPatch(patch, patchSize, oldImage, oldSize, out, newSize);
+
+	// Did we produce the image the patch was made from?
+	return readHash(patch + 24) == hashData64(out, newSize);
+}
+
+} // End of namespace Common
@@ -0,0 +1,95 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/delta.h
+ *  Binary delta patches between two archive images.
+ */
+
+#ifndef COMMON_DELTA_H
+#define COMMON_DELTA_H
+
+#include <string>
+#include <vector>
+
+#include "common/types.h"
+
+namespace Common {
+
+/** A binary delta patch, turning an old image into a new one.
+ *
+ *  The patch is a list of operations producing the new image front to back,
+ *  either copying a range of the old image or adding literal data. Both
+ *  images are identified by their hash, so that a patch is only applied to
+ *  the image it was made for, and its result is verified.
+ */
+class Delta {
+public:
+	Delta(const byte *oldImage, uint32 oldSize, const byte *newImage, uint32 newSize);
+	~Delta();
+
+	/** Produce the next size bytes of the new image by copying them from the old image. */
+	void copy(uint32 oldOffset, uint32 size);
+	/** Produce the next size bytes of the new image by adding them literally. */
+	void add(uint32 size);
+
+	/** Return how much of the new image is produced so far. */
+	uint32 getPosition() const;
+	/** Return how many bytes of the new image are added literally. */
+	uint32 getAddedSize() const;
+
+	/** Write the patch into a file. Fails if it doesn't produce the whole new image. */
+	bool write(const std::string &file) const;
+
+	/** Apply a patch to an old image.
+	 *
+	 *  @param  patch    The whole patch file.
+	 *  @param  oldImage The image the patch was made for.
+	 *  @param  newImage Filled with the new image.
+	 *  @return false if the patch is invalid, was made for a different image or produced the wrong image.
+	 */
+	static bool apply(const byte *patch, uint32 patchSize, const byte *oldImage, uint32 oldSize,
+	                  std::vector<byte> &newImage);
+
+private:
+	const byte *_newImage;
+	uint32 _newSize;
+
+	uint32 _position;
+	uint32 _addedSize;
+
+	/** The offset of the last operation within the patch, to merge adjacent ones. */
+	uint32 _lastOp;
+
+	/** The whole patch: header and operations. */
+	std::vector<byte> _patch;
+};
+
+} // End of namespace Common
+
+#endif // COMMON_DELTA_H
@@ -0,0 +1,482 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/fileio.cpp
+ *  Low-level file I/O helpers working directly on file descriptors.
+ */
+
+#include <cerrno>
+#include <cstdlib>
+
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "common/fileio.h"
+#include "common/util.h"
+
+#ifdef HAVE_MEMFD_CREATE
+	#include <sys/mman.h>
+#endif
+
+#if defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H)
+	#include <sys/sendfile.h>
+	#define USE_SENDFILE 1
+#endif
+
+#ifdef HAVE_VMSPLICE
+	#include <sys/uio.h>
+#endif
+
+#ifndef O_BINARY
+	#define O_BINARY 0
+#endif
+
+namespace Common {
+
+static const uint32 kCopyBufferSize = 1024 * 1024;
+
+int openRead(const std::string &file) {
+	return open(file.c_str(), O_RDONLY | O_BINARY);
+}
+
+int openWrite(const std::string &file) {
+	return open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
+}
+
+int openReadWrite(const std::string &file) {
+	return open(file.c_str(), O_RDWR | O_BINARY);
+}
+
+void closeFile(int fd) {
+	if (fd >= 0)
+		close(fd);
+}
+
+int createMemoryFile(const char *name) {
+#ifdef HAVE_MEMFD_CREATE
+	int memFD = memfd_create(name, MFD_CLOEXEC);
+	if (memFD >= 0)
+		return memFD;
+#endif
+
+#ifdef UNIX
+	const char *tmpDir = getenv("TMPDIR");
+
+	// The name might be anything, keep it out of the path
+	std::string path = std::string((tmpDir && *tmpDir) ? tmpDir : "/tmp") + "/darkseed2-tools.XXXXXX";
+
+	(void) name;
+
+	int fd = mkstemp(&path[0]);
+	if (fd >= 0)
+		unlink(path.c_str());
+
+	return fd;
+#else
+	(void) name;
+	return -1;
+#endif
+}
+
+uint32 getFileSize(int fd) {
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+		return 0xFFFFFFFF;
+
+	if ((st.st_size < 0) || ((uint64) st.st_size >= 0xFFFFFFFFULL))
+		return 0xFFFFFFFF;
+
+	return (uint32) st.st_size;
+}
+
+bool writeData(int fd, const byte *data, uint32 size) {
+	while (size > 0) {
+		ssize_t n = write(fd, data, size);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			return false;
+		}
+
+		data += n;
+		size -= n;
+	}
+
+	return true;
+}
+
+/** pread(), or seeking to the offset and back again where there is none. */
+static ssize_t readAt(int fd, byte *data, uint32 size, uint64 offset) {
+#ifdef UNIX
+	return pread(fd, data, size, (off_t) offset);
+#else
+	const off_t position = lseek(fd, 0, SEEK_CUR);
+	if ((position < 0) || (lseek(fd, (off_t) offset, SEEK_SET) < 0))
+		return -1;
+
+	const ssize_t n = read(fd, data, size);
+
+	lseek(fd, position, SEEK_SET);
+	return n;
+#endif
+}
+
+/** pwrite(), or seeking to the offset and back again where there is none. */
+static ssize_t writeAt(int fd, const byte *data, uint32 size, uint64 offset) {
+#ifdef UNIX
+	return pwrite(fd, data, size, (off_t) offset);
+#else
+	const off_t position = lseek(fd, 0, SEEK_CUR);
+	if ((position < 0) || (lseek(fd, (off_t) offset, SEEK_SET) < 0))
+		return -1;
+
+	const ssize_t n = write(fd, data, size);
+
+	lseek(fd, position, SEEK_SET);
+	return n;
+#endif
+}
+
+bool writeDataAt(int fd, const byte *data, uint32 size, uint32 offset) {
+	while (size > 0) {
+		ssize_t n = writeAt(fd, data, size, offset);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			return false;
+		}
+
+		data   += n;
+		size   -= n;
+		offset += n;
+	}
+
+	return true;
+}
+
+bool readDataAt(int fd, byte *data, uint32 size, uint32 offset) {
+	return readAvailableAt(fd, data, size, offset) == size;
+}
+
+uint32 readAvailableAt(int fd, byte *data, uint32 size, uint64 offset) {
+	uint32 total = 0;
+	while (total < size) {
+		ssize_t n = readAt(fd, data + total, size - total, offset + total);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			break;
+		}
+
+		// Hit the end of the file
+		if (n == 0)
+			break;
+
+		total += n;
+	}
+
+	return total;
+}
+
+bool syncFile(int fd) {
+#ifdef UNIX
+	while (fsync(fd) != 0)
+		if (errno != EINTR)
+			return false;
+#else
+	(void) fd;
+#endif
+
+	return true;
+}
+
+bool syncParentDirectory(const std::string &file) {
+#ifdef UNIX
+	const std::string::size_type slash = file.find_last_of('/');
+
+	std::string dir = ".";
+	if (slash != std::string::npos)
+		dir = (slash == 0) ? "/" : file.substr(0, slash);
+
+	int fd = open(dir.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	bool success = syncFile(fd);
+
+	closeFile(fd);
+	return success;
+#else
+	(void) file;
+	return true;
+#endif
+}
+
+bool createDirectory(const std::string &path) {
+#ifdef UNIX
+	return (mkdir(path.c_str(), 0755) == 0) || (errno == EEXIST);
+#else
+	return (mkdir(path.c_str()) == 0) || (errno == EEXIST);
+#endif
+}
+
+bool createDirectories(const std::string &path) {
+	for (std::string::size_type slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+		if (!createDirectory(path.substr(0, slash)))
+			return false;
+
+		if (slash == std::string::npos)
+			break;
+	}
+
+	return true;
+}
+
+static bool copyDataBuffered(int out, int in, uint32 size) {
+	byte *buffer = new byte[MIN<uint32>(size, kCopyBufferSize)];
+
+	bool result = true;
+	while (result && (size > 0)) {
+		ssize_t n = read(in, buffer, MIN<uint32>(size, kCopyBufferSize));
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			result = false;
+			break;
+		}
+
+		// Unexpected end of file
+		if (n == 0) {
+			result = false;
+			break;
+		}
+
+		result = writeData(out, buffer, n);
+		size  -= n;
+	}
+
+	delete[] buffer;
+	return result;
+}
+
+bool copyData(int out, int in, uint32 size) {
+#ifdef HAVE_COPY_FILE_RANGE
+	while (size > 0) {
+		ssize_t n = copy_file_range(in, 0, out, 0, size, 0);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			// Not supported between these files, fall back to read() and write()
+			// copy_file_range() refuses outputs opened for appending with EBADF
+			if ((errno == ENOSYS) || (errno == EXDEV) || (errno == EINVAL) || (errno == EOPNOTSUPP) ||
+			    (errno == EBADF))
+				break;
+
+			return false;
+		}
+
+		// Unexpected end of file
+		if (n == 0)
+			return false;
+
+		size -= n;
+	}
+#endif
+
+	if (size == 0)
+		return true;
+
+	return copyDataBuffered(out, in, size);
+}
+
+bool copyDataAt(int out, int in, uint32 offset, uint32 size) {
+#ifdef HAVE_COPY_FILE_RANGE
+	loff_t inOffset = offset;
+	while (size > 0) {
+		ssize_t n = copy_file_range(in, &inOffset, out, 0, size, 0);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			// Not supported between these files, fall back to pread() and write()
+			// copy_file_range() refuses outputs opened for appending with EBADF
+			if ((errno == ENOSYS) || (errno == EXDEV) || (errno == EINVAL) || (errno == EOPNOTSUPP) ||
+			    (errno == EBADF))
+				break;
+
+			return false;
+		}
+
+		// Unexpected end of file
+		if (n == 0)
+			return false;
+
+		size -= n;
+	}
+
+	offset = inOffset;
+#endif
+
+	byte *buffer = new byte[MIN<uint32>(size, kCopyBufferSize)];
+
+	bool result = true;
+	while (result && (size > 0)) {
+		ssize_t n = readAt(in, buffer, MIN<uint32>(size, kCopyBufferSize), offset);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			result = false;
+			break;
+		}
+
+		// Unexpected end of file
+		if (n == 0) {
+			result = false;
+			break;
+		}
+
+		result  = writeData(out, buffer, n);
+		offset += n;
+		size   -= n;
+	}
+
+	delete[] buffer;
+	return result;
+}
+
+static bool isPipe(int fd) {
+	struct stat st;
+
+	return (fstat(fd, &st) == 0) && S_ISFIFO(st.st_mode);
+}
+
+bool sendDataAt(int out, int in, uint32 offset, uint32 size) {
+#if defined(HAVE_SPLICE) || defined(USE_SENDFILE)
+	const bool toPipe = isPipe(out);
+#endif
+
+#ifdef HAVE_SPLICE
+	if (toPipe) {
+		loff_t inOffset = offset;
+		while (size > 0) {
+			ssize_t n = splice(in, &inOffset, out, 0, size, SPLICE_F_MORE);
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+
+				// Not supported for this file, fall back to copying
+				if ((errno == ENOSYS) || (errno == EINVAL))
+					break;
+
+				return false;
+			}
+
+			// Unexpected end of file
+			if (n == 0)
+				return false;
+
+			size -= n;
+		}
+
+		offset = inOffset;
+	}
+#endif
+
+#ifdef USE_SENDFILE
+	if (!toPipe) {
+		off_t inOffset = offset;
+		while (size > 0) {
+			ssize_t n = sendfile(out, in, &inOffset, size);
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+
+				// Not supported between these files, fall back to copying
+				if ((errno == ENOSYS) || (errno == EINVAL))
+					break;
+
+				return false;
+			}
+
+			// Unexpected end of file
+			if (n == 0)
+				return false;
+
+			size -= n;
+		}
+
+		offset = inOffset;
+	}
+#endif
+
+	if (size == 0)
+		return true;
+
+	return copyDataAt(out, in, offset, size);
+}
+
+bool sendMemory(int out, const byte *data, uint32 size) {
+#ifdef HAVE_VMSPLICE
+	if (isPipe(out)) {
+		while (size > 0) {
+			struct iovec iov;
+			iov.iov_base = (void *) data;
+			iov.iov_len  = size;
+
+			ssize_t n = vmsplice(out, &iov, 1, 0);
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+
+				// Not supported, fall back to writing
+				if ((errno == ENOSYS) || (errno == EINVAL))
+					break;
+
+				return false;
+			}
+
+			data += n;
+			size -= n;
+		}
+	}
+#endif
+
+	return writeData(out, data, size);
+}
+
+} // End of namespace Common
@@ -0,0 +1,121 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/fileio.h
+ *  Low-level file I/O helpers working directly on file descriptors.
+ */
+
+#ifndef COMMON_FILEIO_H
+#define COMMON_FILEIO_H
+
+#include <string>
+
+#include "common/types.h"
+
+namespace Common {
+
+/** Open a file for reading. Returns -1 on failure. */
+int openRead(const std::string &file);
+/** Create or truncate a file for writing. Returns -1 on failure. */
+int openWrite(const std::string &file);
+/** Open an existing file for reading and writing. Returns -1 on failure. */
+int openReadWrite(const std::string &file);
+/** Close a file descriptor opened with openRead() or openWrite(). */
+void closeFile(int fd);
+
+/** Create an anonymous, memory-backed file, like memfd_create(). Returns -1 on failure.
+ *
+ *  The name is only a label for debugging. Where memfd_create() is not
+ *  available, an unlinked temporary file with a fixed name pattern is used
+ *  instead, so the name never ends up in a path.
+ */
+int createMemoryFile(const char *name);
+
+/** Return the size of an open file, or 0xFFFFFFFF on error. */
+uint32 getFileSize(int fd);
+
+/** Write a full buffer, retrying on short writes. */
+bool writeData(int fd, const byte *data, uint32 size);
+/** Write a full buffer at an offset, leaving the file position untouched.
+ *
+ *  Without pread() and pwrite(), this and the other functions reading or
+ *  writing at an offset seek there and back again, so they're not safe to
+ *  use on a descriptor shared with other threads.
+ */
+bool writeDataAt(int fd, const byte *data, uint32 size, uint32 offset);
+
+/** Read a full buffer from an offset, leaving the file position untouched. */
+bool readDataAt(int fd, byte *data, uint32 size, uint32 offset);
+/** Read up to size bytes from an offset, returning how many could be read before the end of the file. */
+uint32 readAvailableAt(int fd, byte *data, uint32 size, uint64 offset);
+
+/** Make sure everything written to a file has reached the disk. */
+bool syncFile(int fd);
+/** Make sure the entries of the directory containing a file have reached the disk. */
+bool syncParentDirectory(const std::string &file);
+
+/** Create a directory, unless it already exists. */
+bool createDirectory(const std::string &path);
+/** Create a directory and all its missing parents. */
+bool createDirectories(const std::string &path);
+
+/** Copy data from the current position of one file to the current position of another.
+ *
+ *  Uses copy_file_range() where available, so that the kernel can move the
+ *  data without bouncing it through user space, and large buffered reads
+ *  and writes otherwise.
+ */
+bool copyData(int out, int in, uint32 size);
+
+/** Copy data from an offset within one file to the current position of another.
+ *
+ *  Like copyData(), but the file position of the input is left untouched,
+ *  so it is safe to use on file descriptors shared with other processes.
+ */
+bool copyDataAt(int out, int in, uint32 offset, uint32 size);
+
+/** Send data from an offset within a file to another file, a socket or a pipe.
+ *
+ *  Uses splice() into pipes and sendfile() otherwise, so that the data never
+ *  leaves the kernel, and copyDataAt() where neither works.
+ */
+bool sendDataAt(int out, int in, uint32 offset, uint32 size);
+
+/** Write a memory block into a file, handing its pages to a pipe without copying them.
+ *
+ *  Into a pipe, vmsplice() puts the memory's pages themselves into the pipe,
+ *  where the reader may still find them long after this returned. The memory
+ *  must never be written to again, only unmapped, like with discardBuffer().
+ *  Anything else gets a regular write().
+ */
+bool sendMemory(int out, const byte *data, uint32 size);
+
+} // End of namespace Common
+
+#endif // COMMON_FILEIO_H
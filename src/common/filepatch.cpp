@@ -0,0 +1,206 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/filepatch.cpp
+ *  Crash-safe patching of files, through a redo journal.
+ */
+
+#include <cstring>
+
+#include <unistd.h>
+
+#include "common/util.h"
+#include "common/fileio.h"
+#include "common/filepatch.h"
+
+namespace Common {
+
+/** The journal starts with the magic, followed by the number of writes. */
+static const char   kJournalMagic[8]   = { 'D', 'S', '2', 'P', 'A', 'T', 'C', 'H' };
+static const uint32 kJournalHeaderSize = 12;
+
+/** Each write has its offset and size, followed by its data. */
+static const uint32 kWriteHeaderSize = 8;
+
+/** The journal ends with the FNV-1a hash of everything before it. */
+static const uint32 kJournalHashSize = 8;
+
+FilePatch::FilePatch() : _journal(kJournalHeaderSize) {
+	memcpy(&_journal[0], kJournalMagic, 8);
+	writeUint32LE(&_journal[8], 0);
+}
+
+FilePatch::~FilePatch() {
+}
+
+void FilePatch::add(uint32 offset, const byte *data, uint32 size) {
+	Write write;
+
+	write.offset     = offset;
+	write.size       = size;
+	write.dataOffset = _journal.size() + kWriteHeaderSize;
+
+	_journal.resize(write.dataOffset + size);
+
+	writeUint32LE(&_journal[write.dataOffset - 8], offset);
+	writeUint32LE(&_journal[write.dataOffset - 4], size);
+
+	if (size > 0)
+		memcpy(&_journal[write.dataOffset], data, size);
+
+	_writes.push_back(write);
+
+	writeUint32LE(&_journal[8], _writes.size());
+}
+
+std::string FilePatch::getJournalPath(const std::string &file) {
+	return file + ".journal";
+}
+
+bool FilePatch::write(int fd, const byte *journal, const std::vector<Write> &writes) {
+	for (std::vector<Write>::const_iterator w = writes.begin(); w != writes.end(); ++w)
+		if (!writeDataAt(fd, journal + w->dataOffset, w->size, w->offset))
+			return false;
+
+	return syncFile(fd);
+}
+
+bool FilePatch::parse(const byte *journal, uint32 size, std::vector<Write> &writes) {
+	if ((size < (kJournalHeaderSize + kJournalHashSize)) || memcmp(journal, kJournalMagic, 8))
+		return false;
+
+	const uint32 dataSize = size - kJournalHashSize;
+
+	const uint64 hash = hashFNV64(journal, dataSize);
+	if ((readUint32LE(journal + dataSize) != (uint32) (hash & 0xFFFFFFFF)) ||
+	    (readUint32LE(journal + dataSize + 4) != (uint32) (hash >> 32)))
+		return false;
+
+	const uint32 count = readUint32LE(journal + 8);
+
+	uint32 position = kJournalHeaderSize;
+	for (uint32 i = 0; i < count; i++) {
+		if ((dataSize - position) < kWriteHeaderSize)
+			return false;
+
+		Write write;
+
+		write.offset     = readUint32LE(journal + position);
+		write.size       = readUint32LE(journal + position + 4);
+		write.dataOffset = position + kWriteHeaderSize;
+
+		if ((dataSize - write.dataOffset) < write.size)
+			return false;
+
+		writes.push_back(write);
+
+		position = write.dataOffset + write.size;
+	}
+
+	return position == dataSize;
+}
+
+bool FilePatch::apply(const std::string &file) const {
+	const std::string journalPath = getJournalPath(file);
+
+	std::vector<byte> journal(_journal);
+
+	const uint64 hash = hashFNV64(&journal[0], journal.size());
+
+	journal.resize(journal.size() + kJournalHashSize);
+	writeUint32LE(&journal[journal.size() - 8], (uint32) (hash & 0xFFFFFFFF));
+	writeUint32LE(&journal[journal.size() - 4], (uint32) (hash >> 32));
+
+	int fd = openReadWrite(file);
+	if (fd < 0)
+		return false;
+
+	// The journal has to be on the disk before the file is touched
+	int journalFD = openWrite(journalPath);
+
+	bool journaled = (journalFD >= 0) && writeData(journalFD, &journal[0], journal.size()) && syncFile(journalFD);
+
+	closeFile(journalFD);
+
+	journaled = journaled && syncParentDirectory(journalPath);
+	if (!journaled) {
+		closeFile(fd);
+
+		unlink(journalPath.c_str());
+		return false;
+	}
+
+	const bool success = write(fd, &journal[0], _writes);
+
+	closeFile(fd);
+
+	// Keep the journal of a failed patch around for recover()
+	if (!success)
+		return false;
+
+	return (unlink(journalPath.c_str()) == 0) && syncParentDirectory(journalPath);
+}
+
+bool FilePatch::recover(const std::string &file, bool &recovered) {
+	recovered = false;
+
+	const std::string journalPath = getJournalPath(file);
+
+	int journalFD = openRead(journalPath);
+	if (journalFD < 0)
+		return true;
+
+	const uint32 size = getFileSize(journalFD);
+
+	std::vector<byte> journal(MAX<uint32>(size, 1));
+
+	const bool read = (size != 0xFFFFFFFF) && readDataAt(journalFD, &journal[0], size, 0);
+
+	closeFile(journalFD);
+
+	std::vector<Write> writes;
+	if (read && parse(&journal[0], size, writes)) {
+		int fd = openReadWrite(file);
+		if (fd < 0)
+			return false;
+
+		const bool success = write(fd, &journal[0], writes);
+
+		closeFile(fd);
+		if (!success)
+			return false;
+
+		recovered = true;
+	}
+
+	// A broken journal means the file was never touched
+	return (unlink(journalPath.c_str()) == 0) && syncParentDirectory(journalPath);
+}
+
+} // End of namespace Common
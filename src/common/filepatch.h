@@ -0,0 +1,95 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/filepatch.h
+ *  Crash-safe patching of files, through a redo journal.
+ */
+
+#ifndef COMMON_FILEPATCH_H
+#define COMMON_FILEPATCH_H
+
+#include <string>
+#include <vector>
+
+#include "common/types.h"
+
+namespace Common {
+
+/** A set of writes into an existing file, applied all or nothing.
+ *
+ *  All writes are first put into a journal next to the file, which is synced
+ *  to disk before the file itself is touched. Should applying the writes be
+ *  interrupted, recover() finds the journal and applies them again. A journal
+ *  that was not completely written is simply dropped, since the file was not
+ *  touched yet.
+ */
+class FilePatch {
+public:
+	FilePatch();
+	~FilePatch();
+
+	/** Add a write of data to an offset within the file. */
+	void add(uint32 offset, const byte *data, uint32 size);
+
+	/** Apply all writes to the file. */
+	bool apply(const std::string &file) const;
+
+	/** Finish an interrupted apply(), if there is one.
+	 *
+	 *  @param  file      The file that was being patched.
+	 *  @param  recovered Set to true if an interrupted patch was found and applied.
+	 *  @return false on errors.
+	 */
+	static bool recover(const std::string &file, bool &recovered);
+
+	/** Return the path of the journal used for a file. */
+	static std::string getJournalPath(const std::string &file);
+
+private:
+	struct Write {
+		uint32 offset;
+		uint32 size;
+		uint32 dataOffset; ///< Offset of the data within the journal.
+	};
+
+	std::vector<Write> _writes;
+
+	/** The whole journal: header, writes with their data, and a trailing hash. */
+	std::vector<byte> _journal;
+
+	/** Write all the writes from a journal into the file. */
+	static bool write(int fd, const byte *journal, const std::vector<Write> &writes);
+
+	/** Parse and verify a journal. */
+	static bool parse(const byte *journal, uint32 size, std::vector<Write> &writes);
+};
+
+} // End of namespace Common
+
+#endif // COMMON_FILEPATCH_H
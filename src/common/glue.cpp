@@ -0,0 +1,441 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/glue.cpp
+ *  Helpers for handling compressed Glue archives.
+ */
+
+#include <cstring>
+
+#include <vector>
+
+#include "common/util.h"
+#include "common/memreadstream.h"
+#include "common/bufferpool.h"
+#include "common/trace.h"
+#include "common/gluestats.h"
+#include "common/identify.h"
+#include "common/glue.h"
+
+namespace Common {
+
+bool isCompressedGlueStart(const byte *data, uint32 size) {
+	// A compressed glue has at least one full chunk
+	if (size < 2048)
+		return false;
+
+	// Each resource has a 12 byte name, a size and an offset
+	const uint32 numRes  = readUint16LE(data);
+	const uint32 dirSize = 2 + numRes * 20;
+
+	// Check all resources that are within the first chunk
+	for (uint32 i = 0; (i < numRes) && ((2 + (i + 1) * 20) <= size); i++) {
+		const byte *res = data + 2 + i * 20;
+
+		if (!isValidArchiveName(res, 12))
+			return true;
+
+		// The resources have to come after the resource list
+		if ((readUint32LE(res + 12) > 0) && (readUint32LE(res + 16) < dirSize))
+			return true;
+	}
+
+	return false;
+}
+
+// Check whether a glue is compressed by size range and other sanity checks
+bool isCompressedGlue(std::istream &stream) {
+	stream.seekg(0, std::ios_base::beg);
+
+	uint32 fSize = getSize(stream);
+	if (fSize == 0xFFFFFFFF) {
+		// Without knowing the size, all we can go by is the first chunk
+		byte chunk[2048];
+
+		stream.clear();
+		stream.seekg(0, std::ios_base::beg);
+		stream.read((char *) chunk, 2048);
+
+		const uint32 nRead = stream.gcount();
+
+		stream.clear();
+		stream.seekg(0, std::ios_base::beg);
+
+		return isCompressedGlueStart(chunk, nRead);
+	}
+
+	uint32 numRes = readUint16LE(stream);
+
+	// The resource list has to fit
+	if (fSize <= (numRes * 22)) {
+		stream.seekg(0, std::ios_base::beg);
+		return true;
+	}
+
+	// Read the whole resource list at once
+	std::vector<byte> dir(numRes * 20 + 1);
+
+	stream.read((char *) &dir[0], numRes * 20);
+	const bool complete = (uint32) stream.gcount() == (numRes * 20);
+
+	stream.clear();
+	stream.seekg(0, std::ios_base::beg);
+
+	if (!complete)
+		return true;
+
+	for (const byte *res = &dir[0]; numRes-- > 0; res += 20) {
+		if (!isValidArchiveName(res, 12))
+			return true;
+
+		// The resources have to fit
+		if (((uint64) readUint32LE(res + 12) + readUint32LE(res + 16)) > fSize)
+			return true;
+	}
+
+	return false;
+}
+
+#ifdef ENABLE_GLUE_STATS
+
+static thread_local GlueDecodeStats *glueStats = 0;
+
+void setGlueDecodeStats(GlueDecodeStats *stats) {
+	glueStats = stats;
+}
+
+static void countGlueMatch(int32 offset, uint32 count) {
+	glueStats->matches++;
+	glueStats->lengths[count - 3]++;
+
+	uint32 bucket = 0;
+	while ((2 << bucket) <= offset)
+		bucket++;
+
+	glueStats->offsets[bucket]++;
+
+	if ((uint32) offset < count)
+		glueStats->overlaps++;
+}
+
+#endif // ENABLE_GLUE_STATS
+
+// Counting only happens in builds with the analysis mode
+#ifdef ENABLE_GLUE_STATS
+	#define GLUE_STATS(x) do { if (glueStats) { x; } } while (0)
+#else
+	#define GLUE_STATS(x)
+#endif
+
+// Some LZ-variant
+uint32 uncompressGlueChunk(byte *outBuf, const byte *inBuf, int n) {
+	int countRead    = 0;
+	int countWritten = 0;
+
+	uint16 mask;
+	int32 offset;
+	uint32 count;
+
+	mask = 0xFF00 | *inBuf++;
+
+	while (1) {
+		if (mask & 1) {
+			// Direct copy
+
+			mask >>= 1;
+
+			*outBuf++ = *inBuf++;
+			*outBuf++ = *inBuf++;
+
+			countWritten += 2;
+
+			GLUE_STATS(glueStats->literals++);
+
+		} else {
+			// Copy from previous output
+
+			mask >>= 1;
+
+			count = readUint16LE(inBuf);
+			inBuf += 2;
+
+			offset = (count >> 4)  + 1;
+			count  = (count & 0xF) + 3;
+
+			GLUE_STATS(countGlueMatch(offset, count));
+
+			for (int i = 0; i < 8; i++)
+				outBuf[i] = outBuf[-offset + i];
+
+			if (count > 8)
+				for (int i = 0; i < 10; i++)
+					outBuf[i + 8] = outBuf[-offset + 8 + i];
+
+			outBuf += count;
+			countWritten += count;
+		}
+
+		if ((mask & 0xFF00) == 0) {
+			GLUE_STATS(glueStats->blockEnds.push_back(outBuf - glueStats->outputStart));
+
+			countRead += 17;
+			if (countRead >= n)
+				break;
+
+			mask = 0xFF00 | *inBuf++;
+		}
+	}
+
+	return countWritten;
+}
+
+uint32 getUncompressedGlueSize(std::istream &stream) {
+	stream.seekg(0, std::ios_base::beg);
+
+	byte header[2048];
+	stream.read((char *) header, 2048);
+
+	const bool complete = stream.gcount() == 2048;
+
+	stream.clear();
+	stream.seekg(0, std::ios_base::beg);
+
+	if (!complete)
+		return 0;
+
+	uint32 size = readUint32LE(header + 2044) + 128;
+
+	// Sanity check
+	if (size >= (10*1024*1024))
+		return 0;
+
+	return size;
+}
+
+/** Matches copy from at most this many bytes back. */
+static const uint32 kWindowSize = 4096;
+
+/** The most a single chunk can expand to: a final chunk rounded up to 121
+ *  blocks of 8 tokens, each copying up to 18 bytes. */
+static const uint32 kMaxChunkOutput = 121 * 8 * 18;
+
+/** Uncompress a chunk at one of the edges of the output, through a scratch buffer.
+ *
+ *  At the start, matches reach back before the output and read zeros. At the
+ *  end, a chunk can write past what it produces, or claim more than fits.
+ *  Only what fits into the output is copied over.
+ */
+static uint32 uncompressGlueChunkEdge(byte *outBuf, uint32 decoded, uint32 size,
+                                      const byte *inBuf, int n, std::vector<byte> &scratch) {
+	const uint32 window = MIN(decoded, kWindowSize);
+
+	scratch.assign(kWindowSize + kMaxChunkOutput, 0);
+	memcpy(&scratch[kWindowSize - window], outBuf + decoded - window, window);
+
+	const uint32 written = uncompressGlueChunk(&scratch[kWindowSize], inBuf, n);
+
+	memcpy(outBuf + decoded, &scratch[kWindowSize], MIN(written, size - decoded));
+	return written;
+}
+
+// Uncompress a glue from 2048 byte LZ chunks
+bool uncompressGlue(std::istream &stream, byte *outBuf, uint32 size) {
+	stream.seekg(0, std::ios_base::beg);
+
+	// A partial chunk is rounded up to the next 17 byte block
+	byte inBuf[2048 + 17];
+
+	memset(inBuf, 0, sizeof(inBuf));
+
+	stream.read((char *) inBuf, 2048);
+	int nRead = stream.gcount();
+
+	if (nRead != 2048)
+		return false;
+
+	std::vector<byte> scratch;
+
+	uint32 decoded = 0;
+	while (nRead != 0) {
+		uint32 toRead = 2040;
+		uint32 written;
+
+		if (nRead != 2048)
+			// Round up to the next 17 byte block
+			toRead = ((nRead + 16) / 17) * 17;
+
+		// Decompress that chunk
+		{
+			TraceSpan span("uncompress chunk");
+
+			// Away from the edges, the chunk can go straight into the output
+			if ((decoded >= kWindowSize) && ((size - decoded) >= kMaxChunkOutput))
+				written = uncompressGlueChunk(outBuf + decoded, inBuf, toRead);
+			else
+				written = uncompressGlueChunkEdge(outBuf, decoded, size, inBuf, toRead, scratch);
+
+			span.setBytes(written);
+		}
+
+		// More data than the glue claims to hold
+		if (written > (size - decoded)) {
+			stream.clear();
+			return false;
+		}
+
+		decoded += written;
+
+		memset(inBuf, 0, sizeof(inBuf));
+		stream.read((char *) inBuf, 2048);
+		nRead = stream.gcount();
+	}
+
+	// Every chunk overwrote its part of the buffer, only what's left after them needs clearing
+	if (decoded < size)
+		memset(outBuf + decoded, 0, size - decoded);
+
+	stream.clear();
+	return true;
+}
+
+MemoryReadStream *uncompressGlue(std::istream &stream) {
+	uint32 size = getUncompressedGlueSize(stream);
+	if (size == 0)
+		return 0;
+
+	byte *outBuf = allocateBuffer(size);
+
+	if (!uncompressGlue(stream, outBuf, size)) {
+		releaseBuffer(outBuf);
+		return 0;
+	}
+
+	return new MemoryReadStream(outBuf, size, &releaseBuffer);
+}
+
+/** Each block of compressed glue data holds a mask byte and 8 tokens of 2 bytes. */
+static const uint32 kBlockTokens = 8;
+static const uint32 kBlockSize   = 17;
+
+/** A token copies 3 to 18 bytes from up to 4096 bytes back, or 2 literal bytes. */
+static const uint32 kMinMatch    = 3;
+static const uint32 kMaxMatch    = 18;
+
+/** Hashing the next 3 bytes, to find earlier occurrences. */
+static const uint32 kMatchHashBits = 15;
+/** How many earlier occurrences are tried. */
+static const uint32 kMaxMatchTries = 64;
+
+static inline uint32 hashMatch(const byte *data) {
+	return ((data[0] << 16 | data[1] << 8 | data[2]) * 2654435761U) >> (32 - kMatchHashBits);
+}
+
+uint32 getMaxCompressedGlueSize(uint32 size) {
+	// Nothing but literals
+	const uint32 tokens = (size + 1) / 2;
+
+	return ((tokens + kBlockTokens - 1) / kBlockTokens) * kBlockSize;
+}
+
+uint32 compressGlueData(const byte *data, uint32 size, byte *out) {
+	// Earlier positions with the same hash, chained
+	std::vector<int32> head(1 << kMatchHashBits, -1);
+	std::vector<int32> prev(size, -1);
+
+	uint32 outSize = 0, maskPos = 0, tokens = 0;
+	uint32 pos = 0, hashed = 0;
+
+	while (pos < size) {
+		if ((tokens % kBlockTokens) == 0) {
+			maskPos = outSize;
+			out[outSize++] = 0;
+		}
+
+		// Find the longest match within the window
+		uint32 matchLength = 0, matchOffset = 0;
+		if ((pos + kMinMatch) <= size) {
+			const uint32 maxLength = MIN<uint32>(kMaxMatch, size - pos);
+
+			int32 candidate = head[hashMatch(data + pos)];
+			for (uint32 tries = 0; (candidate >= 0) && ((pos - candidate) <= kWindowSize) && (tries < kMaxMatchTries); tries++) {
+				uint32 length = 0;
+				while ((length < maxLength) && (data[candidate + length] == data[pos + length]))
+					length++;
+
+				if (length > matchLength) {
+					matchLength = length;
+					matchOffset = pos - candidate;
+
+					if (length == maxLength)
+						break;
+				}
+
+				candidate = prev[candidate];
+			}
+		}
+
+		uint32 advance;
+		if (matchLength >= kMinMatch) {
+			writeUint16LE(out + outSize, ((matchOffset - 1) << 4) | (matchLength - kMinMatch));
+			advance = matchLength;
+		} else {
+			// A literal copies two bytes, even at the very end
+			out[maskPos] |= 1 << (tokens % kBlockTokens);
+
+			out[outSize    ] = data[pos];
+			out[outSize + 1] = ((pos + 1) < size) ? data[pos + 1] : 0;
+			advance = 2;
+		}
+
+		outSize += 2;
+		tokens++;
+
+		pos = MIN<uint32>(pos + advance, size);
+
+		// Remember every position passed over
+		for (; (hashed < pos) && ((hashed + kMinMatch) <= size); hashed++) {
+			const uint32 hash = hashMatch(data + hashed);
+
+			prev[hashed] = head[hash];
+			head[hash]   = hashed;
+		}
+	}
+
+	// Fill up the last block with literals
+	for (; (tokens % kBlockTokens) != 0; tokens++) {
+		out[maskPos] |= 1 << (tokens % kBlockTokens);
+
+		out[outSize++] = 0;
+		out[outSize++] = 0;
+	}
+
+	return outSize;
+}
+
+} // End of namespace Common
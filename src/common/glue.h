@@ -0,0 +1,87 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/glue.h
+ *  Helpers for handling compressed Glue archives.
+ */
+
+#ifndef COMMON_GLUE_H
+#define COMMON_GLUE_H
+
+#include <istream>
+
+#include "common/types.h"
+
+namespace Common {
+
+class MemoryReadStream;
+
+/** Check whether a glue is compressed by size range and other sanity checks.
+ *
+ *  For streams that can't tell their size, only the first chunk is checked.
+ */
+bool isCompressedGlue(std::istream &stream);
+
+/** Check whether a glue is compressed, by its first chunk alone. */
+bool isCompressedGlueStart(const byte *data, uint32 size);
+
+/** Return the size of the buffer needed to uncompress a glue, or 0 if it's not a valid compressed glue. */
+uint32 getUncompressedGlueSize(std::istream &stream);
+
+/** Uncompress a single chunk of a glue, returning the number of bytes written. */
+uint32 uncompressGlueChunk(byte *outBuf, const byte *inBuf, int n);
+
+/** Uncompress a glue into a buffer of the size returned by getUncompressedGlueSize().
+ *
+ *  Fails if the glue holds more data than that.
+ */
+bool uncompressGlue(std::istream &stream, byte *outBuf, uint32 size);
+
+/** Uncompress a glue into a new memory stream. Returns 0 on failure. */
+MemoryReadStream *uncompressGlue(std::istream &stream);
+
+/** Return the most compressGlueData() can produce for data of this size. */
+uint32 getMaxCompressedGlueSize(uint32 size);
+
+/** Compress data into the token format of glue chunks.
+ *
+ *  The result is a single run of 17 byte blocks, without the chunk framing
+ *  of a compressed glue file. It can be uncompressed in one go with
+ *  uncompressGlueChunk(), into a buffer with at least 32 bytes of slack.
+ *
+ *  @param  data The data to compress.
+ *  @param  size The size of the data.
+ *  @param  out  A buffer of at least getMaxCompressedGlueSize() bytes.
+ *  @return The size of the compressed data.
+ */
+uint32 compressGlueData(const byte *data, uint32 size, byte *out);
+
+} // End of namespace Common
+
+#endif // COMMON_GLUE_H
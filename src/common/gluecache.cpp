@@ -0,0 +1,327 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/gluecache.cpp
+ *  An on-disk cache of uncompressed glues.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <list>
+#include <string>
+#include <fstream>
+#include <atomic>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+
+#include "common/util.h"
+#include "common/fileio.h"
+#include "common/memreadstream.h"
+#include "common/bufferpool.h"
+#include "common/glue.h"
+#include "common/gluecache.h"
+
+#ifdef HAVE_SYS_MMAN_H
+	#include <sys/mman.h>
+#endif
+
+namespace Common {
+
+/** Each cached image starts with this header. */
+static const char   kCacheMagic[8]   = { 'D', 'S', '2', 'G', 'L', 'U', 'E', '2' };
+static const uint32 kCacheHeaderSize = 48;
+
+/** The header starts with the magic and the identity of the glue, followed by the image size. */
+static const uint32 kCacheIdentitySize = 44;
+
+static void writeUint64LE(byte *data, uint64 value) {
+	writeUint32LE(data    , value & 0xFFFFFFFF);
+	writeUint32LE(data + 4, value >> 32);
+}
+
+/** Write the parts of the header identifying the glue. */
+static void writeIdentity(byte *header, const GlueIdentity &identity) {
+	memcpy(header, kCacheMagic, 8);
+	writeUint64LE(header +  8, identity.device);
+	writeUint64LE(header + 16, identity.inode);
+	writeUint64LE(header + 24, identity.mTime);
+	writeUint64LE(header + 32, identity.cTime);
+	writeUint32LE(header + 40, identity.size);
+}
+
+/** Cached images, and the temporary files they are written into first. */
+static const char *kCacheExtension = ".glue";
+static const char *kTempExtension  = ".tmp";
+
+/** Temporary files left alone for this many seconds were left behind by a crash. */
+static const time_t kStaleTempAge = 60 * 60;
+
+/** Numbers the temporary files, so that threads of the same process never share one. */
+static std::atomic<uint32> tempFileCounter(0);
+
+/** A memory stream over a cached image mapped into memory. */
+class CachedGlueStream : public MemoryReadStream {
+public:
+	CachedGlueStream(byte *mapping, uint32 mappingSize) :
+		MemoryReadStream(mapping + kCacheHeaderSize, mappingSize - kCacheHeaderSize),
+		_mapping(mapping), _mappingSize(mappingSize) {
+	}
+
+	~CachedGlueStream() {
+#ifdef HAVE_SYS_MMAN_H
+		munmap(_mapping, _mappingSize);
+#else
+		delete[] _mapping;
+#endif
+	}
+
+private:
+	byte  *_mapping;
+	uint32 _mappingSize;
+};
+
+GlueCache::GlueCache(const std::string &directory, uint64 maxSize) : _directory(directory), _maxSize(maxSize) {
+	createDirectories(_directory);
+}
+
+GlueCache::~GlueCache() {
+}
+
+std::string GlueCache::getDefaultDirectory() {
+	const char *cacheHome = getenv("XDG_CACHE_HOME");
+	if (cacheHome && *cacheHome)
+		return std::string(cacheHome) + "/darkseed2-tools/glue";
+
+	const char *home = getenv("HOME");
+	if (home && *home)
+		return std::string(home) + "/.cache/darkseed2-tools/glue";
+
+	return "";
+}
+
+MemoryReadStream *GlueCache::uncompressGlue(const std::string &path, std::istream &stream) {
+	struct stat st;
+	if ((stat(path.c_str(), &st) != 0) || (st.st_size >= 0xFFFFFFFF))
+		return Common::uncompressGlue(stream);
+
+	GlueIdentity identity;
+	identity.device = st.st_dev;
+	identity.inode  = st.st_ino;
+	identity.size   = st.st_size;
+
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+	identity.mTime  = (uint64) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+	identity.cTime  = (uint64) st.st_ctim.tv_sec * 1000000000 + st.st_ctim.tv_nsec;
+#else
+	identity.mTime  = st.st_mtime;
+	identity.cTime  = st.st_ctime;
+#endif
+
+	// Name the cache file by the identity, so that finding it doesn't need to read the glue
+	byte key[kCacheHeaderSize];
+	writeIdentity(key, identity);
+
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx", (unsigned long long) hashData64(key, kCacheIdentitySize));
+
+	const std::string file = _directory + "/" + name + kCacheExtension;
+
+	MemoryReadStream *cached = load(file, identity);
+	if (cached)
+		return cached;
+
+	// Not in the cache, uncompress it ourselves and remember the result
+
+	uint32 size = getUncompressedGlueSize(stream);
+	if (size == 0)
+		return 0;
+
+	byte *data = allocateBuffer(size);
+	if (!Common::uncompressGlue(stream, data, size)) {
+		releaseBuffer(data);
+		return 0;
+	}
+
+	store(file, identity, data, size);
+
+	return new MemoryReadStream(data, size, &releaseBuffer);
+}
+
+MemoryReadStream *GlueCache::load(const std::string &file, const GlueIdentity &identity) {
+	int fd = openRead(file);
+	if (fd < 0)
+		return 0;
+
+	const uint32 size = getFileSize(fd);
+	if ((size == 0xFFFFFFFF) || (size <= kCacheHeaderSize)) {
+		closeFile(fd);
+		return 0;
+	}
+
+#ifdef HAVE_SYS_MMAN_H
+	void *mapping = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	closeFile(fd);
+	if (mapping == MAP_FAILED)
+		return 0;
+#else
+	byte *mapping = new byte[size];
+
+	bool success = (read(fd, mapping, size) == (ssize_t) size);
+
+	closeFile(fd);
+	if (!success) {
+		delete[] mapping;
+		return 0;
+	}
+#endif
+
+	CachedGlueStream *cached = new CachedGlueStream((byte *) mapping, size);
+
+	byte expected[kCacheHeaderSize];
+	writeIdentity(expected, identity);
+
+	const byte *header = (const byte *) mapping;
+	if (memcmp(header, expected, kCacheIdentitySize) || (readUint32LE(header + kCacheIdentitySize) != (size - kCacheHeaderSize))) {
+
+		delete cached;
+		return 0;
+	}
+
+	// Mark it as recently used
+	utime(file.c_str(), 0);
+
+	return cached;
+}
+
+void GlueCache::store(const std::string &file, const GlueIdentity &identity, const byte *data, uint32 size) {
+	byte header[kCacheHeaderSize];
+
+	writeIdentity(header, identity);
+	writeUint32LE(header + kCacheIdentitySize, size);
+
+	char suffix[32];
+	std::snprintf(suffix, sizeof(suffix), ".%u.%u%s", (uint) getpid(), (uint) tempFileCounter++, kTempExtension);
+
+	/* Write into a temporary file and atomically rename it into place. It's
+	 * synced first, so that a crash can't leave an empty image behind the rename. */
+	const std::string tmpFile = file + suffix;
+
+	int fd = openWrite(tmpFile);
+	if (fd < 0)
+		return;
+
+	bool success = writeData(fd, header, kCacheHeaderSize) && writeData(fd, data, size) && syncFile(fd);
+
+	closeFile(fd);
+
+	if (!success || (rename(tmpFile.c_str(), file.c_str()) != 0)) {
+		unlink(tmpFile.c_str());
+		return;
+	}
+
+	trim();
+}
+
+struct CacheEntry {
+	std::string file;
+	time_t lastUse;
+	uint64 size;
+
+	bool operator<(const CacheEntry &right) const {
+		return lastUse < right.lastUse;
+	}
+};
+
+static bool hasExtension(const std::string &name, const char *extension) {
+	const size_t length = strlen(extension);
+
+	return (name.size() > length) && !name.compare(name.size() - length, length, extension);
+}
+
+void GlueCache::trim() {
+	DIR *dir = opendir(_directory.c_str());
+	if (!dir)
+		return;
+
+	std::list<CacheEntry> entries;
+	uint64 totalSize = 0;
+
+	const time_t now = time(0);
+
+	struct dirent *dirEntry;
+	while ((dirEntry = readdir(dir))) {
+		const std::string name = dirEntry->d_name;
+
+		const bool temp = hasExtension(name, kTempExtension);
+		if (!temp && !hasExtension(name, kCacheExtension))
+			continue;
+
+		CacheEntry entry;
+		entry.file = _directory + "/" + name;
+
+		struct stat st;
+		if (stat(entry.file.c_str(), &st) != 0)
+			continue;
+
+		// Temporary files are only ours to remove once nobody could still be writing them
+		if (temp) {
+			if ((now - st.st_mtime) > kStaleTempAge)
+				unlink(entry.file.c_str());
+
+			continue;
+		}
+
+		entry.lastUse = st.st_mtime;
+		entry.size    = st.st_size;
+
+		entries.push_back(entry);
+		totalSize += entry.size;
+	}
+
+	closedir(dir);
+
+	if (totalSize <= _maxSize)
+		return;
+
+	// Evict the least recently used images first
+	entries.sort();
+
+	for (std::list<CacheEntry>::const_iterator e = entries.begin(); (e != entries.end()) && (totalSize > _maxSize); ++e)
+		if (unlink(e->file.c_str()) == 0)
+			totalSize -= e->size;
+}
+
+} // End of namespace Common
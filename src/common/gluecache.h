@@ -0,0 +1,94 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/gluecache.h
+ *  An on-disk cache of uncompressed glues.
+ */
+
+#ifndef COMMON_GLUECACHE_H
+#define COMMON_GLUECACHE_H
+
+#include <string>
+#include <istream>
+
+#include "common/types.h"
+
+namespace Common {
+
+class MemoryReadStream;
+
+/** What identifies a glue file in the cache. */
+struct GlueIdentity {
+	uint64 device;
+	uint64 inode;
+	uint64 mTime; ///< In nanoseconds where the system has them, otherwise seconds.
+	uint64 cTime;
+	uint32 size;
+};
+
+/** A directory of uncompressed glue images, shared between invocations.
+ *
+ *  The images are keyed by the identity of the glue file: its device, inode,
+ *  size, and modification and change times. Finding an image never needs to
+ *  read the glue itself. New images are written and synced to a temporary
+ *  file first and then renamed into place, so concurrent users never see
+ *  partial images.
+ *  Once the cache grows over its size limit, the least recently used images
+ *  are removed.
+ */
+class GlueCache {
+public:
+	/** Create a cache in this directory, holding at most maxSize bytes. */
+	GlueCache(const std::string &directory, uint64 maxSize);
+	~GlueCache();
+
+	/** Return the default cache directory, within $XDG_CACHE_HOME, or "" if there's no home directory. */
+	static std::string getDefaultDirectory();
+
+	/** Return an uncompressed glue, from the cache if possible.
+	 *
+	 *  @param  path   The path of the compressed glue file.
+	 *  @param  stream The compressed glue.
+	 *  @return A stream of the uncompressed glue, or 0 on failure.
+	 */
+	MemoryReadStream *uncompressGlue(const std::string &path, std::istream &stream);
+
+private:
+	std::string _directory;
+	uint64 _maxSize;
+
+	MemoryReadStream *load(const std::string &file, const GlueIdentity &identity);
+	void store(const std::string &file, const GlueIdentity &identity, const byte *data, uint32 size);
+
+	void trim();
+};
+
+} // End of namespace Common
+
+#endif // COMMON_GLUECACHE_H
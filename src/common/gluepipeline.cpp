@@ -0,0 +1,292 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/gluepipeline.cpp
+ *  Extracting compressed glues with reading, uncompressing and writing overlapped.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include <vector>
+#include <thread>
+#include <functional>
+
+#include "common/util.h"
+#include "common/glue.h"
+#include "common/archive.h"
+#include "common/spscqueue.h"
+#include "common/bufferpool.h"
+#include "common/trace.h"
+#include "common/commandrunner.h"
+#include "common/outputdir.h"
+#include "common/progress.h"
+#include "common/gluepipeline.h"
+
+namespace Common {
+
+/** Size of a compressed chunk. */
+static const uint32 kChunkSize = 2048;
+/** Number of chunks read at once. */
+static const uint32 kBlockChunks = 32;
+static const uint32 kBlockSize   = kChunkSize * kBlockChunks;
+/** Number of input blocks in flight. */
+static const uint32 kBlockCount = 8;
+/** Number of extracted files that can be waiting for the writer. */
+static const uint32 kReadyQueueSize = 256;
+
+/** The most a single chunk can expand to: a final chunk rounded up to 121
+ *  blocks of 8 tokens, each copying up to 18 bytes. */
+static const uint32 kMaxChunkOutput = 121 * 8 * 18;
+
+struct InputBlock {
+	byte  *data;
+	uint32 size;
+};
+
+/** The uncompressed glue, as shared between the stages. */
+struct GlueImage {
+	byte  *data;
+	uint32 size;
+
+	std::vector<FileInfo> files;
+
+	GlueImage() : data(0), size(0) {
+	}
+
+	~GlueImage() {
+		releaseBuffer(data);
+	}
+};
+
+static void readStage(std::istream &glue, SPSCQueue<InputBlock *> &freeBlocks, SPSCQueue<InputBlock *> &fullBlocks) {
+	setTraceThreadName("reader");
+
+	InputBlock *block;
+	while (freeBlocks.pop(block)) {
+		{
+			TraceSpan span("read block");
+
+			glue.read((char *) block->data, kBlockSize);
+			block->size = glue.gcount();
+
+			span.setBytes(block->size);
+		}
+
+		// Pad a final, partial chunk with zeros; its last block might be read past the end
+		memset(block->data + block->size, 0, kBlockSize + kChunkSize - block->size);
+
+		if (block->size == 0)
+			break;
+
+		fullBlocks.push(block);
+
+		if (block->size < kBlockSize)
+			break;
+	}
+
+	fullBlocks.close();
+}
+
+static void writeStage(const GlueImage &image, SPSCQueue<uint32> &readyFiles, CommandRunner *runner,
+                       const OutputDirectory *output, ProgressReporter &progress) {
+	setTraceThreadName("writer");
+
+	uint32 index;
+	while (readyFiles.pop(index)) {
+		const FileInfo &file = image.files[index];
+
+		TraceSpan span("write member", file.name);
+		span.setBytes(file.size);
+
+		bool success = (file.offset <= image.size) && (file.size <= (image.size - file.offset));
+		if (success) {
+			if (runner)
+				success = runner->run(file.name, image.data + file.offset, file.size);
+			else
+				success = output->writeFile(file.name, image.data + file.offset, file.size);
+		}
+
+		progress.reportFile(index, file.name, file.size, success);
+	}
+}
+
+/** Uncompress all chunks within a block. */
+static bool decodeBlock(GlueImage &image, const InputBlock &block, uint32 &decoded) {
+	if (!image.data) {
+		// The first chunk holds the uncompressed size
+		if (block.size < kChunkSize)
+			return false;
+
+		image.size = readUint32LE(block.data + kChunkSize - 4) + 128;
+
+		// Sanity check
+		if (image.size >= (10*1024*1024))
+			return false;
+
+		// Leave room for a broken chunk to overshoot. The chunks overwrite the buffer
+		// front to back, so it's only cleared after the last one
+		image.data = allocateBuffer(image.size + kMaxChunkOutput);
+	}
+
+	for (uint32 offset = 0; offset < block.size; offset += kChunkSize) {
+		const uint32 nRead = MIN<uint32>(block.size - offset, kChunkSize);
+
+		uint32 toRead = 2040;
+		if (nRead != kChunkSize)
+			// Round up to the next 17 byte block
+			toRead = ((nRead + 16) / 17) * 17;
+
+		TraceSpan span("uncompress chunk");
+
+		const uint32 written = uncompressGlueChunk(image.data + decoded, block.data + offset, toRead);
+		span.setBytes(written);
+
+		decoded += written;
+		if (decoded > image.size)
+			return false;
+	}
+
+	return true;
+}
+
+/** Parse the directory, once it has been fully uncompressed. */
+static bool parseDirectory(GlueImage &image, uint32 decoded, ProgressReporter &progress) {
+	typedef ArchiveLayout<GlueFormat> Layout;
+
+	if (decoded < Layout::kHeaderSize)
+		return false;
+
+	const uint32 count = Layout::readCount(image.data);
+	if (decoded < Layout::getDataStart(count))
+		return false;
+
+	TraceSpan span("parse directory");
+	span.setBytes(Layout::getDataStart(count));
+
+	std::list<FileInfo> files;
+	parseFileList<GlueFormat>(image.data + Layout::kHeaderSize, count, files);
+
+	image.files.assign(files.begin(), files.end());
+
+	// The writer takes over reporting with the first file handed to it
+	progress.start(count);
+	return true;
+}
+
+static void printStats(const char *name, const char *items, const QueueStats &stats, uint32 capacity) {
+	std::fprintf(stderr, "  %-20s %8llu %-6s  average fill %6.2f/%-4u  producer waits %6llu  consumer waits %6llu\n",
+	             name, (unsigned long long) stats.items, items, stats.getAverageOccupancy(), capacity,
+	             (unsigned long long) stats.fullWaits, (unsigned long long) stats.emptyWaits);
+}
+
+bool extractCompressedGlue(std::istream &glue, bool printStatistics, CommandRunner *runner, const OutputDirectory *output,
+                           ProgressReporter &progress) {
+	glue.seekg(0, std::ios_base::beg);
+
+	SPSCQueue<InputBlock *> freeBlocks(kBlockCount), fullBlocks(kBlockCount);
+	SPSCQueue<uint32> readyFiles(kReadyQueueSize);
+
+	// The input buffers are recycled between the reader and the uncompressor
+	InputBlock blocks[kBlockCount];
+	for (uint32 i = 0; i < kBlockCount; i++) {
+		blocks[i].data = new byte[kBlockSize + kChunkSize];
+		blocks[i].size = 0;
+
+		freeBlocks.push(&blocks[i]);
+	}
+
+	GlueImage image;
+
+	std::thread reader(readStage, std::ref(glue), std::ref(freeBlocks), std::ref(fullBlocks));
+	std::thread writer(writeStage, std::cref(image), std::ref(readyFiles), runner, output, std::ref(progress));
+
+	bool failed = false, haveFiles = false;
+	uint32 decoded = 0, nextFile = 0;
+
+	InputBlock *block;
+	while (fullBlocks.pop(block)) {
+		// After a failure, keep taking blocks so that the reader can finish
+		if (!failed)
+			failed = !decodeBlock(image, *block, decoded);
+
+		freeBlocks.push(block);
+
+		if (failed)
+			continue;
+
+		if (!haveFiles)
+			haveFiles = parseDirectory(image, decoded, progress);
+
+		// Hand every file that's complete to the writer
+		while (haveFiles && (nextFile < image.files.size()) &&
+		       ((image.files[nextFile].offset + (uint64) image.files[nextFile].size) <= decoded))
+			readyFiles.push(nextFile++);
+	}
+
+	// Not even a complete directory, treat it like a failed uncompression
+	if (!haveFiles)
+		failed = true;
+
+	// Whatever's left reaches past the uncompressed data, which reads as zeros
+	if (!failed && (decoded < (image.size + kMaxChunkOutput)))
+		memset(image.data + decoded, 0, image.size + kMaxChunkOutput - decoded);
+
+	while (!failed && (nextFile < image.files.size()))
+		readyFiles.push(nextFile++);
+
+	readyFiles.close();
+
+	reader.join();
+	writer.join();
+
+	for (uint32 i = 0; i < kBlockCount; i++)
+		delete[] blocks[i].data;
+
+	if (failed) {
+		std::printf("Failed to uncompress the glue\n");
+		return false;
+	}
+
+	if (printStatistics) {
+		std::fprintf(stderr, "\nPipeline statistics:\n");
+
+		printStats("read -> uncompress" , "blocks", fullBlocks.getStats(), fullBlocks.getCapacity());
+		printStats("uncompress -> write", "files" , readyFiles.getStats(), readyFiles.getCapacity());
+
+		const BufferPoolStats poolStats = getBufferPoolStats();
+		std::fprintf(stderr, "  %-20s %8llu new     %llu reused, %llu bytes allocated\n", "buffer pool",
+		             (unsigned long long) poolStats.allocations, (unsigned long long) poolStats.reuses,
+		             (unsigned long long) poolStats.allocated);
+	}
+
+	return true;
+}
+
+} // End of namespace Common
@@ -0,0 +1,63 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/gluepipeline.h
+ *  Extracting compressed glues with reading, uncompressing and writing overlapped.
+ */
+
+#ifndef COMMON_GLUEPIPELINE_H
+#define COMMON_GLUEPIPELINE_H
+
+#include <istream>
+
+namespace Common {
+
+class CommandRunner;
+class OutputDirectory;
+class ProgressReporter;
+
+/** Extract all files from a compressed glue.
+ *
+ *  Reading the compressed data, uncompressing it and writing the extracted
+ *  files runs in three threads, connected by bounded lock-free queues. Each
+ *  file is written as soon as it has been fully uncompressed.
+ *
+ *  @param  glue       The compressed glue.
+ *  @param  printStats Print how full the queues between the stages were.
+ *  @param  runner     If given, hand the files to this command runner instead of writing them.
+ *  @param  output     Otherwise, write the files into this directory.
+ *  @param  progress   Report the extracted files here.
+ *  @return false if the glue could not be uncompressed.
+ */
+bool extractCompressedGlue(std::istream &glue, bool printStats, CommandRunner *runner, const OutputDirectory *output,
+                           ProgressReporter &progress);
+
+} // End of namespace Common
+
+#endif // COMMON_GLUEPIPELINE_H
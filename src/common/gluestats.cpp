@@ -0,0 +1,237 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/gluestats.cpp
+ *  Analysis of how compressed glues decode, built with --enable-glue-stats.
+ */
+
+#include "common/gluestats.h"
+
+#ifdef ENABLE_GLUE_STATS
+
+#include <cstdio>
+#include <cstring>
+
+#include <list>
+#include <chrono>
+#include <algorithm>
+
+#include "common/util.h"
+#include "common/archive.h"
+#include "common/glue.h"
+
+namespace Common {
+
+static const uint32 kChunkSize     = 2048;
+static const uint32 kChunkDataSize = 2040;
+static const uint32 kBlockSize     = 17;
+
+/** The most a single chunk can uncompress to: every token a maximum length match. */
+static const uint32 kMaxChunkOutput = 121 * 8 * 18;
+/** Matches reach up to this far back, even before the start of the image. */
+static const uint32 kWindowSize = 4096;
+
+/** What decoding a single chunk took. */
+struct ChunkStats {
+	uint32 input;
+	uint32 output;
+	uint64 cycles;
+};
+
+#if defined(__i386__) || defined(__x86_64__)
+static const char *kCycleUnit = "cycles";
+
+static uint64 readCycles() {
+	return __builtin_ia32_rdtsc();
+}
+#else
+static const char *kCycleUnit = "ns";
+
+static uint64 readCycles() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+GlueDecodeStats::GlueDecodeStats(const byte *start) : outputStart(start), literals(0), matches(0), overlaps(0) {
+	memset(lengths, 0, sizeof(lengths));
+	memset(offsets, 0, sizeof(offsets));
+}
+
+static double getPercent(uint64 part, uint64 whole) {
+	return (whole == 0) ? 0.0 : ((100.0 * part) / whole);
+}
+
+static bool readWholeGlue(std::istream &glue, std::vector<byte> &data) {
+	glue.clear();
+	glue.seekg(0, std::ios_base::beg);
+
+	byte buffer[64 * 1024];
+	while (glue.good()) {
+		glue.read((char *) buffer, sizeof(buffer));
+		data.insert(data.end(), buffer, buffer + glue.gcount());
+	}
+
+	glue.clear();
+	return data.size() >= kChunkSize;
+}
+
+/** Return how many compressed bytes the uncompressed data up to this offset took.
+ *
+ *  Within a block, the cost is spread evenly over the bytes it produced.
+ */
+static double getCompressedCost(const std::vector<uint32> &blockEnds, uint32 offset) {
+	std::vector<uint32>::const_iterator end = std::lower_bound(blockEnds.begin(), blockEnds.end(), offset);
+	if (end == blockEnds.end())
+		return (double) blockEnds.size() * kBlockSize;
+
+	const uint32 block = end - blockEnds.begin();
+	const uint32 start = (block == 0) ? 0 : blockEnds[block - 1];
+
+	double cost = (double) block * kBlockSize;
+	if (*end > start)
+		cost += (double) kBlockSize * (offset - start) / (*end - start);
+
+	return cost;
+}
+
+static void printTokens(const GlueDecodeStats &stats, uint32 compressedSize, uint32 size, uint32 chunkCount) {
+	uint64 matchBytes = 0;
+	for (uint32 i = 0; i < GlueDecodeStats::kLengthCount; i++)
+		matchBytes += stats.lengths[i] * (i + 3);
+
+	std::printf("Compressed size:     %u bytes in %u chunks\n", compressedSize, chunkCount);
+	std::printf("Uncompressed size:   %u bytes (compressed to %.1f%%)\n", size, getPercent(compressedSize, size));
+	std::printf("Literal tokens:      %llu\n", (unsigned long long) stats.literals);
+	std::printf("Match tokens:        %llu (%.1f%% of the output)\n", (unsigned long long) stats.matches,
+	            getPercent(matchBytes, matchBytes + stats.literals * 2));
+	std::printf("Overlapping matches: %llu (%.1f%% of the matches)\n", (unsigned long long) stats.overlaps,
+	            getPercent(stats.overlaps, stats.matches));
+
+	std::printf("\nMatch lengths:\n");
+	for (uint32 i = 0; i < GlueDecodeStats::kLengthCount; i++)
+		std::printf("  %9u  %10llu  %5.1f%%\n", i + 3, (unsigned long long) stats.lengths[i],
+		            getPercent(stats.lengths[i], stats.matches));
+
+	std::printf("\nMatch offsets:\n");
+	for (uint32 i = 0; i < GlueDecodeStats::kOffsetCount; i++)
+		std::printf("  %4u-%4u  %10llu  %5.1f%%\n", 1 << i, MIN<uint32>((2 << i) - 1, 4096),
+		            (unsigned long long) stats.offsets[i], getPercent(stats.offsets[i], stats.matches));
+}
+
+static void printChunks(const std::vector<ChunkStats> &chunks) {
+	uint64 output = 0, cycles = 0;
+	for (std::vector<ChunkStats>::const_iterator c = chunks.begin(); c != chunks.end(); ++c) {
+		output += c->output;
+		cycles += c->cycles;
+	}
+
+	std::printf("\nDecoding:            %.2f %s per byte\n", (output == 0) ? 0.0 : ((double) cycles / output), kCycleUnit);
+
+	std::printf("\n Chunk |  Input | Output | %s/byte\n", kCycleUnit);
+	std::printf("=======|========|========|============\n");
+
+	for (uint32 i = 0; i < chunks.size(); i++)
+		std::printf("%6u | %6u | %6u | %10.2f\n", i, chunks[i].input, chunks[i].output,
+		            (chunks[i].output == 0) ? 0.0 : ((double) chunks[i].cycles / chunks[i].output));
+}
+
+static void printFiles(const GlueDecodeStats &stats, const std::list<FileInfo> &files) {
+	std::printf("\n Filename    |       Size | Compressed | Ratio\n");
+	std::printf("=============|============|============|=======\n");
+
+	for (std::list<FileInfo>::const_iterator f = files.begin(); f != files.end(); ++f) {
+		const double cost = getCompressedCost(stats.blockEnds, f->offset + f->size) -
+		                    getCompressedCost(stats.blockEnds, f->offset);
+
+		std::printf("%12s | %10u | %10.0f | %5.1f%%\n", f->name, f->size, cost,
+		            (f->size == 0) ? 0.0 : ((100.0 * cost) / f->size));
+	}
+}
+
+bool analyzeGlue(std::istream &glue) {
+	std::vector<byte> compressed;
+	if (!readWholeGlue(glue, compressed))
+		return false;
+
+	const uint32 size = readUint32LE(&compressed[kChunkSize - 4]);
+	if (size >= (10*1024*1024))
+		return false;
+
+	// The image is preceded by zeros for matches reaching back before its start
+	std::vector<byte> buffer(kWindowSize + size + kMaxChunkOutput);
+	byte *image = &buffer[kWindowSize];
+
+	GlueDecodeStats stats(image);
+	std::vector<ChunkStats> chunks;
+
+	uint32 decoded = 0;
+	for (uint32 offset = 0; offset < compressed.size(); offset += kChunkSize) {
+		ChunkStats chunk;
+
+		chunk.input = MIN<uint32>(compressed.size() - offset, kChunkSize);
+
+		// Round a partial chunk up to the next block, padded with zeros
+		byte input[kChunkSize + kBlockSize];
+		memset(input, 0, sizeof(input));
+		memcpy(input, &compressed[offset], chunk.input);
+
+		const uint32 toRead = (chunk.input == kChunkSize) ? kChunkDataSize : (((chunk.input + 16) / 17) * 17);
+
+		if (decoded > size)
+			return false;
+
+		// Time the decoder as it is, then decode again to count
+		const uint64 start = readCycles();
+		chunk.output = uncompressGlueChunk(image + decoded, input, toRead);
+		chunk.cycles = readCycles() - start;
+
+		setGlueDecodeStats(&stats);
+		uncompressGlueChunk(image + decoded, input, toRead);
+		setGlueDecodeStats(0);
+
+		chunks.push_back(chunk);
+		decoded += chunk.output;
+	}
+
+	printTokens(stats, compressed.size(), size, chunks.size());
+	printChunks(chunks);
+
+	std::list<FileInfo> files;
+	if (parseArchiveImage<GlueFormat>(image, MIN(decoded, size), files))
+		printFiles(stats, files);
+	else
+		std::printf("\nThe directory is broken, can't tell the files apart\n");
+
+	return true;
+}
+
+} // End of namespace Common
+
+#endif // ENABLE_GLUE_STATS
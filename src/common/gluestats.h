@@ -0,0 +1,82 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/gluestats.h
+ *  Analysis of how compressed glues decode, built with --enable-glue-stats.
+ */
+
+#ifndef COMMON_GLUESTATS_H
+#define COMMON_GLUESTATS_H
+
+#include "common/types.h"
+
+#ifdef ENABLE_GLUE_STATS
+
+#include <vector>
+#include <istream>
+
+namespace Common {
+
+/** Counters filled in by uncompressGlueChunk(), while set with setGlueDecodeStats(). */
+struct GlueDecodeStats {
+	/** Match lengths are 3 to 18 bytes. */
+	static const uint32 kLengthCount = 16;
+	/** Match offsets are counted by their highest bit, 1 to 4096. */
+	static const uint32 kOffsetCount = 13;
+
+	const byte *outputStart; ///< Start of the uncompressed image, to find where blocks end.
+
+	uint64 literals;   ///< Tokens holding two literal bytes.
+	uint64 matches;    ///< Tokens copying from earlier output.
+	uint64 overlaps;   ///< Matches reaching into their own output, like runs.
+
+	uint64 lengths[kLengthCount];
+	uint64 offsets[kOffsetCount];
+
+	/** Offset within the uncompressed image after each 17 byte block of tokens. */
+	std::vector<uint32> blockEnds;
+
+	GlueDecodeStats(const byte *start = 0);
+};
+
+/** Count the work of uncompressGlueChunk() on the calling thread into these statistics, or stop with 0. */
+void setGlueDecodeStats(GlueDecodeStats *stats);
+
+/** Uncompress a glue while counting everything, and print a report.
+ *
+ *  Besides the token statistics, this prints the cost of every chunk and
+ *  how many compressed bytes each file within the glue takes.
+ */
+bool analyzeGlue(std::istream &glue);
+
+} // End of namespace Common
+
+#endif // ENABLE_GLUE_STATS
+
+#endif // COMMON_GLUESTATS_H
@@ -0,0 +1,315 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/gluestream.cpp
+ *  Uncompressing glues front to back, through a small window.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include <vector>
+
+#include "common/util.h"
+#include "common/fileio.h"
+#include "common/glue.h"
+#include "common/trace.h"
+#include "common/commandrunner.h"
+#include "common/outputdir.h"
+#include "common/progress.h"
+#include "common/gluestream.h"
+
+namespace Common {
+
+static const uint32 kChunkSize     = 2048;
+static const uint32 kChunkDataSize = 2040;
+
+/** How far back matches can copy from. */
+static const uint32 kWindowSize = 4096;
+
+/** The most a single chunk can expand to: a final chunk rounded up to 121
+ *  blocks of 8 tokens, each copying up to 18 bytes. */
+static const uint32 kMaxChunkOutput = 121 * 8 * 18;
+
+GlueStreamDecoder::GlueStreamDecoder() : _window(0), _outputSize(0), _offset(0) {
+	_buffer = new byte[kWindowSize + kMaxChunkOutput];
+
+	memset(_buffer, 0, kWindowSize + kMaxChunkOutput);
+}
+
+GlueStreamDecoder::~GlueStreamDecoder() {
+	delete[] _buffer;
+}
+
+uint32 GlueStreamDecoder::getMemorySize() {
+	return kWindowSize + kMaxChunkOutput;
+}
+
+const byte *GlueStreamDecoder::getOutput() const {
+	return _buffer + _window;
+}
+
+uint32 GlueStreamDecoder::getOutputSize() const {
+	return _outputSize;
+}
+
+uint32 GlueStreamDecoder::getOutputOffset() const {
+	return _offset;
+}
+
+void GlueStreamDecoder::decodeChunk(const byte *chunk, uint32 size) {
+	// Slide the window over the end of the output so far
+	const uint32 keep = MIN(_window + _outputSize, kWindowSize);
+
+	memmove(_buffer, _buffer + _window + _outputSize - keep, keep);
+
+	_offset += _outputSize;
+	_window  = keep;
+
+	// A final, partial chunk is rounded up to the next 17 byte block, padded with zeros
+	byte input[kChunkSize + 17];
+
+	memset(input, 0, sizeof(input));
+	memcpy(input, chunk, MIN(size, kChunkSize));
+
+	const uint32 toRead = (size >= kChunkSize) ? kChunkDataSize : (((size + 16) / 17) * 17);
+
+	TraceSpan span("uncompress chunk");
+
+	_outputSize = uncompressGlueChunk(_buffer + _window, input, toRead);
+	span.setBytes(_outputSize);
+}
+
+/** A file being extracted while the glue streams by. */
+struct StreamedFile {
+	FileInfo info;
+	uint32 index;
+
+	uint32 written; ///< How much of the file has been written so far.
+	bool failed;
+
+	OutputFile output;
+	std::vector<byte> data; ///< The data collected for the command runner.
+
+	StreamedFile(const FileInfo &i, uint32 n) : info(i), index(n), written(0), failed(false) {
+	}
+};
+
+/** Hand a file's data to its destination. */
+static void writeStreamedFile(StreamedFile &file, const byte *data, uint32 size, CommandRunner *runner,
+                              const OutputDirectory *output) {
+
+	if (file.failed || (size == 0))
+		return;
+
+	if (runner) {
+		file.data.insert(file.data.end(), data, data + size);
+		return;
+	}
+
+	if (!file.output.isOpen() && !output->create(file.info.name, file.output)) {
+		file.failed = true;
+		return;
+	}
+
+	if (!file.output.write(data, size))
+		file.failed = true;
+}
+
+static void finishStreamedFile(StreamedFile &file, CommandRunner *runner, const OutputDirectory *output,
+                               ProgressReporter &progress) {
+
+	TraceSpan span("write member", file.info.name);
+	span.setBytes(file.info.size);
+
+	bool success = !file.failed;
+
+	if (runner) {
+		if (success)
+			success = runner->run(file.info.name, file.data.empty() ? 0 : &file.data[0], file.data.size());
+
+		std::vector<byte>().swap(file.data);
+	} else {
+		// An empty file hasn't been created yet
+		if (success && !file.output.isOpen())
+			success = output->create(file.info.name, file.output);
+
+		if (success)
+			success = file.output.commit();
+		else
+			file.output.discard();
+	}
+
+	progress.reportFile(file.index, file.info.name, file.info.size, success);
+}
+
+/** Pass a part of the uncompressed glue to all files it belongs to.
+ *
+ *  The files are sorted by their offset, and the parts come front to back.
+ */
+static void streamOutput(std::list<StreamedFile> &files, const byte *data, uint32 offset, uint32 size,
+                         CommandRunner *runner, const OutputDirectory *output, ProgressReporter &progress) {
+
+	const uint64 end = (uint64) offset + size;
+
+	std::list<StreamedFile>::iterator f = files.begin();
+	while ((f != files.end()) && (f->info.offset < end)) {
+		const uint64 from = MAX<uint64>((uint64) f->info.offset + f->written, offset);
+		const uint64 to   = MIN<uint64>((uint64) f->info.offset + f->info.size, end);
+
+		if (from < to) {
+			writeStreamedFile(*f, data + (from - offset), to - from, runner, output);
+
+			f->written += to - from;
+		}
+
+		if (f->written < f->info.size) {
+			++f;
+			continue;
+		}
+
+		finishStreamedFile(*f, runner, output, progress);
+		f = files.erase(f);
+	}
+}
+
+static bool isBeforeInGlue(const StreamedFile &a, const StreamedFile &b) {
+	return a.info.offset < b.info.offset;
+}
+
+bool streamCompressedGlue(std::istream &glue, bool extract, CommandRunner *runner, const OutputDirectory *output,
+                          ProgressReporter &progress, std::list<FileInfo> &files) {
+
+	typedef ArchiveLayout<GlueFormat> Layout;
+
+	glue.seekg(0, std::ios_base::beg);
+
+	GlueStreamDecoder decoder;
+
+	// The uncompressed glue up to the end of the directory
+	std::vector<byte> head;
+	bool haveFiles = false;
+
+	std::list<StreamedFile> pending;
+
+	uint32 imageSize = 0;
+
+	byte chunk[kChunkSize];
+	while (true) {
+		{
+			TraceSpan span("read block");
+
+			glue.read((char *) chunk, kChunkSize);
+			span.setBytes(glue.gcount());
+		}
+
+		const uint32 size = glue.gcount();
+		if (size == 0)
+			break;
+
+		if (imageSize == 0) {
+			// The first chunk holds the uncompressed size
+			if (size < kChunkSize)
+				return false;
+
+			imageSize = readUint32LE(chunk + kChunkSize - 4) + 128;
+			if (imageSize >= (10*1024*1024))
+				return false;
+		}
+
+		decoder.decodeChunk(chunk, size);
+
+		const byte  *decoded       = decoder.getOutput();
+		const uint32 decodedSize   = decoder.getOutputSize();
+		const uint32 decodedOffset = decoder.getOutputOffset();
+
+		if (((uint64) decodedOffset + decodedSize) > imageSize)
+			return false;
+
+		if (haveFiles) {
+			streamOutput(pending, decoded, decodedOffset, decodedSize, runner, output, progress);
+			continue;
+		}
+
+		head.insert(head.end(), decoded, decoded + decodedSize);
+		if ((head.size() < Layout::kHeaderSize) || (head.size() < Layout::getDataStart(Layout::readCount(&head[0]))))
+			continue;
+
+		TraceSpan span("parse directory");
+
+		const uint32 count = Layout::readCount(&head[0]);
+		span.setBytes(Layout::getDataStart(count));
+
+		parseFileList<GlueFormat>(&head[Layout::kHeaderSize], count, files);
+		haveFiles = true;
+
+		if (!extract)
+			return true;
+
+		uint32 index = 0;
+		for (std::list<FileInfo>::const_iterator f = files.begin(); f != files.end(); ++f, ++index)
+			pending.emplace_back(*f, index);
+
+		pending.sort(isBeforeInGlue);
+
+		progress.start(count);
+
+		// Everything uncompressed so far, directory included
+		streamOutput(pending, &head[0], 0, head.size(), runner, output, progress);
+
+		std::vector<byte>().swap(head);
+	}
+
+	if (!haveFiles)
+		return false;
+
+	// What's left reaches past the uncompressed data, which reads as zeros up to the stated size
+	static const byte kZeros[4096] = { 0 };
+
+	while (!pending.empty()) {
+		StreamedFile &file = pending.front();
+
+		if (((uint64) file.info.offset + file.info.size) > imageSize)
+			file.failed = true;
+
+		while (!file.failed && (file.written < file.info.size)) {
+			const uint32 size = MIN<uint32>(file.info.size - file.written, sizeof(kZeros));
+
+			writeStreamedFile(file, kZeros, size, runner, output);
+			file.written += size;
+		}
+
+		finishStreamedFile(file, runner, output, progress);
+		pending.pop_front();
+	}
+
+	return true;
+}
+
+} // End of namespace Common
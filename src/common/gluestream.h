@@ -0,0 +1,101 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/gluestream.h
+ *  Uncompressing glues front to back, through a small window.
+ */
+
+#ifndef COMMON_GLUESTREAM_H
+#define COMMON_GLUESTREAM_H
+
+#include <list>
+#include <istream>
+
+#include "common/types.h"
+#include "common/archive.h"
+
+namespace Common {
+
+class CommandRunner;
+class OutputDirectory;
+class ProgressReporter;
+
+/** Uncompresses a glue one chunk at a time, keeping only the output matches can reach back into.
+ *
+ *  Matches copy from at most 4096 bytes back, so besides the output of the
+ *  current chunk, only that much of the earlier output is kept.
+ */
+class GlueStreamDecoder {
+public:
+	GlueStreamDecoder();
+	~GlueStreamDecoder();
+
+	/** Uncompress the next chunk. The last one may be shorter than 2048 bytes. */
+	void decodeChunk(const byte *chunk, uint32 size);
+
+	/** The output of the last chunk. */
+	const byte *getOutput() const;
+	uint32 getOutputSize() const;
+	/** Where the output of the last chunk lies within the uncompressed glue. */
+	uint32 getOutputOffset() const;
+
+	/** Return how much memory a decoder takes. */
+	static uint32 getMemorySize();
+
+private:
+	byte *_buffer;
+
+	uint32 _window;     ///< Earlier output kept in front of the current output.
+	uint32 _outputSize;
+	uint32 _offset;
+
+	// Not copyable
+	GlueStreamDecoder(const GlueStreamDecoder &);
+	GlueStreamDecoder &operator=(const GlueStreamDecoder &);
+};
+
+/** Read the directory of a compressed glue and extract its files, never holding the whole glue in memory.
+ *
+ *  Each file is written while its data streams by, files handed to a command
+ *  runner are collected one by one.
+ *
+ *  @param  glue     The compressed glue.
+ *  @param  extract  Extract the files, instead of only reading the directory.
+ *  @param  runner   If given, hand the files to this command runner instead of writing them.
+ *  @param  output   Otherwise, write the files into this directory.
+ *  @param  progress Report the extracted files here.
+ *  @param  files    Filled with the files within the glue.
+ *  @return false if the glue could not be uncompressed.
+ */
+bool streamCompressedGlue(std::istream &glue, bool extract, CommandRunner *runner, const OutputDirectory *output,
+                          ProgressReporter &progress, std::list<FileInfo> &files);
+
+} // End of namespace Common
+
+#endif // COMMON_GLUESTREAM_H
@@ -0,0 +1,275 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/identify.cpp
+ *  Telling the archive formats apart by the start of a file alone.
+ */
+
+#include <cctype>
+#include <cstring>
+
+#ifdef __SSE2__
+	#include <emmintrin.h>
+#endif
+
+#include "common/util.h"
+#include "common/fileio.h"
+#include "common/glue.h"
+#include "common/archive.h"
+#include "common/identify.h"
+
+namespace Common {
+
+static const char *kArchiveTypeName[kArchiveMAX] = {
+	"unknown", "PGF", "TND", "Glue", "compressed Glue"
+};
+
+static const char *kConfidenceName[kConfidenceMAX] = {
+	"none", "low", "medium", "high"
+};
+
+/** The most a single chunk can expand to: a final chunk rounded up to 121
+ *  blocks of 8 tokens, each copying at most 18 bytes. */
+static const uint32 kMaxChunkOutput = 121 * 8 * 18;
+
+#ifdef __SSE2__
+
+/** Set every byte that lies within [lo, hi]. Bytes >= 0x80 are negative and never do. */
+static __m128i inRange(__m128i c, char lo, char hi) {
+	return _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8(lo - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8(hi + 1)));
+}
+
+bool isValidArchiveName(const byte *name, uint32 length) {
+	const __m128i c = _mm_loadu_si128((const __m128i *) name);
+
+	__m128i valid = _mm_or_si128(inRange(c, '0', '9'), _mm_or_si128(inRange(c, 'A', 'Z'), inRange(c, 'a', 'z')));
+	valid = _mm_or_si128(valid, _mm_cmpeq_epi8(c, _mm_set1_epi8('.')));
+	valid = _mm_or_si128(valid, _mm_cmpeq_epi8(c, _mm_set1_epi8('_')));
+
+	const uint32 invalid = ~_mm_movemask_epi8(valid) & 0xFFFF;
+	const uint32 zeroes  =  _mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_setzero_si128()));
+
+	// Only the bytes before the end of the name and before the first 0 count
+	uint32 end = MIN<uint32>(length, 16);
+	if (zeroes != 0)
+		end = MIN<uint32>(end, __builtin_ctz(zeroes));
+
+	return (invalid & ((1 << end) - 1)) == 0;
+}
+
+#else
+
+bool isValidArchiveName(const byte *name, uint32 length) {
+	for (uint32 i = 0; (i < length) && (name[i] != 0); i++)
+		if (!isalnum(name[i]) && (name[i] != '.') && (name[i] != '_'))
+			return false;
+
+	return true;
+}
+
+#endif
+
+/** Check the header and as much of the directory as is available.
+ *
+ *  @param  data     The start of the archive.
+ *  @param  size     The number of bytes in data.
+ *  @param  fileSize The size of the whole archive, or 0xFFFFFFFF if unknown.
+ *  @param  count    Set to the number of files within the archive.
+ */
+template<class Format>
+static IdentifyConfidence checkDirectory(const byte *data, uint32 size, uint32 fileSize, uint32 &count) {
+	typedef ArchiveLayout<Format> Layout;
+
+	const bool knownSize = fileSize != 0xFFFFFFFF;
+
+	if ((size < Layout::kHeaderSize) || (knownSize && (fileSize < Layout::kHeaderSize)))
+		return kConfidenceNone;
+
+	count = Layout::readCount(data);
+
+	// The directory has to fit into the archive
+	const uint64 dataStart = Layout::kHeaderSize + (uint64) count * Layout::kEntrySize;
+	if (knownSize && (dataStart > fileSize))
+		return kConfidenceNone;
+
+	// The size field is the first thing to rule an archive in or out
+	bool sizeMatches = false;
+	if (Format::kHasSizeField) {
+		if (knownSize && (Layout::Order::read32(data) != fileSize))
+			return kConfidenceNone;
+
+		sizeMatches = knownSize;
+	}
+
+	if (count == 0)
+		return kConfidenceLow;
+
+	const uint64 offsetBias = Format::kRelativeOffsets ? dataStart : 0;
+
+	uint32 checked = 0;
+	for (const byte *entry = data + Layout::kHeaderSize; (checked < count) &&
+	     ((entry + Layout::kEntrySize) <= (data + size)); entry += Layout::kEntrySize, checked++) {
+
+		if ((entry[0] == 0) || !isValidArchiveName(entry, Format::kNameLength))
+			return kConfidenceNone;
+
+		const uint32 fSize   = Layout::Order::read32(entry + Format::kNameLength);
+		const uint64 fOffset = Layout::Order::read32(entry + Format::kNameLength + 4) + offsetBias;
+
+		// The data has to come after the directory, and within the archive
+		if ((fSize > 0) && (fOffset < dataStart))
+			return kConfidenceNone;
+		if (knownSize && ((fOffset + fSize) > fileSize))
+			return kConfidenceNone;
+	}
+
+	if ((checked == count) && knownSize)
+		return kConfidenceHigh;
+	if ((checked > 0) || sizeMatches)
+		return kConfidenceMedium;
+
+	return kConfidenceLow;
+}
+
+/** Uncompress the first chunk of a possibly compressed glue and check the directory in it. */
+static IdentifyConfidence checkCompressedGlue(const byte *data, uint32 size, uint32 fileSize, uint32 &count) {
+	// A compressed glue has at least one full chunk, and a sane uncompressed size
+	if ((size < 2048) || ((fileSize != 0xFFFFFFFF) && (fileSize < 2048)))
+		return kConfidenceNone;
+
+	const uint32 imageSize = readUint32LE(data + 2044);
+	if ((imageSize == 0) || (imageSize >= (10*1024*1024)))
+		return kConfidenceNone;
+
+	/* Matches reach up to 4096 bytes back, so the output gets an empty window
+	 * in front of it. Any file could end up here, not just valid glues. */
+	static const uint32 kWindowSize = 4096;
+
+	byte buffer[kWindowSize + kMaxChunkOutput + 32];
+	memset(buffer, 0, kWindowSize);
+
+	byte *chunk = buffer + kWindowSize;
+
+	const uint32 written = uncompressGlueChunk(chunk, data, 2040);
+
+	IdentifyConfidence confidence = checkDirectory<GlueFormat>(chunk, MIN(written, imageSize), imageSize, count);
+
+	// Without the size of the file, nothing says the glue isn't cut short
+	if ((fileSize == 0xFFFFFFFF) && (confidence == kConfidenceHigh))
+		confidence = kConfidenceMedium;
+
+	return confidence;
+}
+
+ArchiveIdentity identifyArchive(const byte *data, uint32 size, uint32 fileSize) {
+	size = MIN(size, kIdentifySize);
+
+	ArchiveIdentity identity;
+
+	IdentifyConfidence confidence[kArchiveMAX];
+	uint32 count[kArchiveMAX];
+
+	memset(count, 0, sizeof(count));
+
+	confidence[kArchiveUnknown]        = kConfidenceNone;
+	confidence[kArchivePGF]            = checkDirectory<PGFFormat> (data, size, fileSize, count[kArchivePGF]);
+	confidence[kArchiveTND]            = checkDirectory<TNDFormat> (data, size, fileSize, count[kArchiveTND]);
+	confidence[kArchiveGlue]           = checkDirectory<GlueFormat>(data, size, fileSize, count[kArchiveGlue]);
+	confidence[kArchiveCompressedGlue] = kConfidenceNone;
+
+	// Only a glue that isn't a valid uncompressed one can be a compressed one
+	if (confidence[kArchiveGlue] == kConfidenceNone)
+		confidence[kArchiveCompressedGlue] = checkCompressedGlue(data, size, fileSize, count[kArchiveCompressedGlue]);
+
+	// Go with the most certain type, the first one on a tie
+	for (int i = 0; i < kArchiveMAX; i++) {
+		if (confidence[i] > identity.confidence) {
+			identity.type       = (ArchiveType) i;
+			identity.confidence = confidence[i];
+			identity.fileCount  = count[i];
+		}
+	}
+
+	return identity;
+}
+
+ArchiveIdentity identifyArchive(std::istream &stream) {
+	stream.clear();
+	stream.seekg(0, std::ios_base::beg);
+
+	const uint32 fileSize = getSize(stream);
+
+	byte data[kIdentifySize];
+
+	stream.clear();
+	stream.seekg(0, std::ios_base::beg);
+	stream.read((char *) data, kIdentifySize);
+
+	const uint32 nRead = stream.gcount();
+
+	stream.clear();
+	stream.seekg(0, std::ios_base::beg);
+
+	return identifyArchive(data, nRead, fileSize);
+}
+
+bool identifyArchiveFile(const std::string &path, ArchiveIdentity &identity) {
+	int fd = openRead(path);
+	if (fd < 0)
+		return false;
+
+	const uint32 fileSize = getFileSize(fd);
+
+	byte data[kIdentifySize];
+
+	const uint32 size = MIN(fileSize, kIdentifySize);
+
+	bool success = (fileSize != 0xFFFFFFFF) && readDataAt(fd, data, size, 0);
+	if (success)
+		identity = identifyArchive(data, size, fileSize);
+
+	closeFile(fd);
+	return success;
+}
+
+const char *getArchiveTypeName(ArchiveType type) {
+	if ((type < 0) || (type >= kArchiveMAX))
+		return kArchiveTypeName[kArchiveUnknown];
+
+	return kArchiveTypeName[type];
+}
+
+const char *getConfidenceName(IdentifyConfidence confidence) {
+	if ((confidence < 0) || (confidence >= kConfidenceMAX))
+		return kConfidenceName[kConfidenceNone];
+
+	return kConfidenceName[confidence];
+}
+
+} // End of namespace Common
@@ -0,0 +1,108 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/identify.h
+ *  Telling the archive formats apart by the start of a file alone.
+ */
+
+#ifndef COMMON_IDENTIFY_H
+#define COMMON_IDENTIFY_H
+
+#include <string>
+#include <istream>
+
+#include "common/types.h"
+
+namespace Common {
+
+enum ArchiveType {
+	kArchiveUnknown       ,
+	kArchivePGF           ,
+	kArchiveTND           ,
+	kArchiveGlue          ,
+	kArchiveCompressedGlue,
+	kArchiveMAX
+};
+
+/** How sure identifyArchive() is about the archive type. */
+enum IdentifyConfidence {
+	kConfidenceNone  , ///< Not an archive of that type.
+	kConfidenceLow   , ///< The header fits, but none of the directory could be checked.
+	kConfidenceMedium, ///< The checked part of the directory is valid, but not all of it was checked.
+	kConfidenceHigh  , ///< The whole directory was checked against the size of the archive.
+	kConfidenceMAX
+};
+
+struct ArchiveIdentity {
+	ArchiveType type;
+	IdentifyConfidence confidence;
+
+	uint32 fileCount; ///< The number of files within the archive.
+
+	ArchiveIdentity() : type(kArchiveUnknown), confidence(kConfidenceNone), fileCount(0) {
+	}
+};
+
+/** The most that is read of a file to identify it. */
+static const uint32 kIdentifySize = 4096;
+
+/** Identify an archive by its start.
+ *
+ *  For a compressed glue, only the first chunk is uncompressed, and its
+ *  directory checked against the uncompressed size.
+ *
+ *  @param  data     The first bytes of the file, at most kIdentifySize are looked at.
+ *  @param  size     The number of bytes in data.
+ *  @param  fileSize The size of the whole file, or 0xFFFFFFFF if unknown.
+ */
+ArchiveIdentity identifyArchive(const byte *data, uint32 size, uint32 fileSize);
+
+/** Identify an archive by the start of a stream, leaving the stream rewound. */
+ArchiveIdentity identifyArchive(std::istream &stream);
+
+/** Identify a regular file with a single read.
+ *
+ *  @return false if the path couldn't be opened as a file.
+ */
+bool identifyArchiveFile(const std::string &path, ArchiveIdentity &identity);
+
+const char *getArchiveTypeName(ArchiveType type);
+const char *getConfidenceName(IdentifyConfidence confidence);
+
+/** Does this directory entry name only consist of the characters allowed in archives?
+ *
+ *  These are letters, digits, '.' and '_', up to the first 0. At least 16
+ *  bytes have to be readable at name, regardless of the length, so that the
+ *  check can look at them all at once.
+ */
+bool isValidArchiveName(const byte *name, uint32 length);
+
+} // End of namespace Common
+
+#endif // COMMON_IDENTIFY_H
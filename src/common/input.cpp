@@ -0,0 +1,115 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/input.cpp
+ *  Opening the input files of the tools.
+ */
+
+#include <fstream>
+
+#include <sys/stat.h>
+
+#include "common/fileio.h"
+#include "common/pipestream.h"
+#include "common/input.h"
+#include "common/cdimage.h"
+
+namespace Common {
+
+static std::istream *openCDFile(const std::string &imagePath, const std::string &path) {
+	CDImage *image = new CDImage;
+
+	uint32 sector, size;
+	if (!image->open(imagePath) || !image->findFile(path, sector, size)) {
+		delete image;
+		return 0;
+	}
+
+	return new CDFileStream(image, sector, size, true);
+}
+
+bool isSequentialInput(const std::string &path) {
+	if (path == "-")
+		return true;
+
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+		return false;
+
+	if (S_ISFIFO(st.st_mode) || S_ISCHR(st.st_mode))
+		return true;
+
+#ifdef S_ISSOCK
+	if (S_ISSOCK(st.st_mode))
+		return true;
+#endif
+
+	return false;
+}
+
+std::istream *openInputFile(const std::string &path) {
+	if (path == "-")
+		return new PipeReadStream(0, false);
+
+	if (isSequentialInput(path)) {
+		int fd = openRead(path);
+		if (fd < 0)
+			return 0;
+
+		return new PipeReadStream(fd, true);
+	}
+
+	std::ifstream *file = new std::ifstream(path.c_str(), std::ios_base::in | std::ios_base::binary);
+	if (file->is_open())
+		return file;
+
+	delete file;
+
+	// Look for a CD image among the leading path components
+	std::string::size_type slash = path.size();
+	while ((slash = path.find_last_of("/\\", slash - 1)) != std::string::npos) {
+		if (slash == 0)
+			break;
+
+		const std::string imagePath = path.substr(0, slash);
+
+		struct stat st;
+		if (stat(imagePath.c_str(), &st) != 0)
+			continue;
+
+		if (!S_ISREG(st.st_mode))
+			break;
+
+		return openCDFile(imagePath, path.substr(slash + 1));
+	}
+
+	return 0;
+}
+
+} // End of namespace Common
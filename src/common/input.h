@@ -0,0 +1,61 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/input.h
+ *  Opening the input files of the tools.
+ */
+
+#ifndef COMMON_INPUT_H
+#define COMMON_INPUT_H
+
+#include <string>
+#include <istream>
+
+namespace Common {
+
+/** Open a file for reading.
+ *
+ *  Besides regular files, this also opens files within CD images: when a
+ *  path like "disc.bin/DATA/FILE.PGF" doesn't exist on disk, but "disc.bin"
+ *  is a readable CD image, the rest of the path is looked up within the
+ *  image's ISO9660 file system.
+ *
+ *  The path "-" stands for stdin. Pipes and other files that can't seek
+ *  are opened as a PipeReadStream, see isSequentialInput().
+ *
+ *  @return The opened stream, which has to be deleted by the caller, or 0 on failure.
+ */
+std::istream *openInputFile(const std::string &path);
+
+/** Can this input file only be read front to back? True for stdin, pipes, sockets and character devices. */
+bool isSequentialInput(const std::string &path);
+
+} // End of namespace Common
+
+#endif // COMMON_INPUT_H
@@ -0,0 +1,80 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/memorybudget.cpp
+ *  Admission control, keeping concurrent work within a memory limit.
+ */
+
+#include "common/util.h"
+#include "common/memorybudget.h"
+
+namespace Common {
+
+MemoryBudget::MemoryBudget(uint64 limit) : _limit(limit), _reserved(0), _peak(0), _turn(0) {
+}
+
+MemoryBudget::~MemoryBudget() {
+}
+
+uint64 MemoryBudget::getLimit() const {
+	return _limit;
+}
+
+uint64 MemoryBudget::getPeak() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	return _peak;
+}
+
+uint64 MemoryBudget::reserve(uint32 item, uint64 size) {
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	// Whatever is too big to ever fit only waits until it's alone
+	while ((_turn != item) ||
+	       ((_limit != 0) && (size != 0) && (_reserved != 0) && ((_reserved + size) > _limit)))
+		_changed.wait(lock);
+
+	_reserved += size;
+	_peak      = MAX(_peak, _reserved);
+
+	_turn++;
+
+	_changed.notify_all();
+	return size;
+}
+
+void MemoryBudget::release(uint64 size) {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	_reserved -= size;
+
+	_changed.notify_all();
+}
+
+} // End of namespace Common
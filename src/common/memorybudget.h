@@ -0,0 +1,94 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/memorybudget.h
+ *  Admission control, keeping concurrent work within a memory limit.
+ */
+
+#ifndef COMMON_MEMORYBUDGET_H
+#define COMMON_MEMORYBUDGET_H
+
+#include <mutex>
+#include <condition_variable>
+
+#include "common/types.h"
+
+namespace Common {
+
+/** A limit on the memory that concurrent work may take up at the same time.
+ *
+ *  Work items are numbered from 0 in the order they are consumed in, and
+ *  reserve their memory under that number before they start. Reservations
+ *  are granted strictly in that order, so that an item that is waited on can
+ *  never be starved by items after it holding the memory.
+ *
+ *  A reservation bigger than the whole limit is granted once nothing else is
+ *  reserved, and holds back every other reservation until it is released.
+ */
+class MemoryBudget {
+public:
+	/** @param limit The limit in bytes, or 0 for no limit. */
+	MemoryBudget(uint64 limit);
+	~MemoryBudget();
+
+	uint64 getLimit() const;
+	/** Return the most memory that was reserved at the same time. */
+	uint64 getPeak() const;
+
+	/** Wait for the work item's turn and for enough memory to be free, then reserve it.
+	 *
+	 *  Every item has to reserve exactly once, a size of 0 just passes the turn on.
+	 *
+	 *  @param  item The number of the work item.
+	 *  @param  size The memory the item needs.
+	 *  @return The reserved size, to be given back with release().
+	 */
+	uint64 reserve(uint32 item, uint64 size);
+
+	/** Give back memory from reserve(). */
+	void release(uint64 size);
+
+private:
+	uint64 _limit;
+	uint64 _reserved;
+	uint64 _peak;
+
+	uint32 _turn; ///< The work item whose reservation is up next.
+
+	mutable std::mutex _mutex;
+	std::condition_variable _changed;
+
+	// Not copyable
+	MemoryBudget(const MemoryBudget &);
+	MemoryBudget &operator=(const MemoryBudget &);
+};
+
+} // End of namespace Common
+
+#endif // COMMON_MEMORYBUDGET_H
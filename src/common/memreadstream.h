@@ -0,0 +1,124 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/memreadstream.h
+ *  A class wrapping a memory block into an std::istream.
+ */
+
+#ifndef COMMON_MEMREADSTREAM_H
+#define COMMON_MEMREADSTREAM_H
+
+#include <istream>
+#include <streambuf>
+
+#include "common/types.h"
+
+namespace Common {
+
+/** A class wrapping a memory block into an std::istream. */
+class MemoryReadStream : public std::istream {
+private:
+	class StreamBuf : public std::streambuf {
+	public:
+		StreamBuf(byte *data, uint32 size) {
+			setg((char *) data, (char *) data, (char *) data + size);
+		}
+
+		~StreamBuf() {
+		}
+
+		std::streampos seekoff(std::streamoff off, std::ios_base::seekdir way, std::ios_base::openmode which) {
+			if (!(which & std::ios_base::in))
+				return -1;
+
+			int32 offset = 0;
+			if      (way == std::ios_base::beg)
+				offset = off;
+			else if (way == std::ios_base::cur)
+				offset = (gptr() - eback()) + off;
+			else if (way == std::ios_base::end)
+				offset = (egptr() - eback()) + off;
+
+			if ((offset < 0) || (offset >= (egptr() - eback())))
+				return -1;
+
+			setg(eback(), eback() + offset, egptr());
+			return offset;
+		}
+
+		std::streampos seekpos(std::streampos sp, std::ios_base::openmode which) {
+			return seekoff(sp, std::ios_base::beg, which);
+		}
+	};
+
+	StreamBuf _streamBuf;
+
+	byte  *_data;
+	uint32 _size;
+
+public:
+	/** A function freeing the memory block, once the stream is destroyed. */
+	typedef void (*Disposer)(byte *data);
+
+	MemoryReadStream(byte *data, uint32 size, bool dispose = false) :
+		std::istream(0), _streamBuf(data, size), _data(data), _size(size), _disposer(dispose ? &deleteArray : 0) {
+
+		rdbuf(&_streamBuf);
+	}
+
+	MemoryReadStream(byte *data, uint32 size, Disposer disposer) :
+		std::istream(0), _streamBuf(data, size), _data(data), _size(size), _disposer(disposer) {
+
+		rdbuf(&_streamBuf);
+	}
+
+	~MemoryReadStream() {
+		if (_disposer)
+			_disposer(_data);
+	}
+
+	const byte *getData() const {
+		return _data;
+	}
+
+	uint32 getSize() const {
+		return _size;
+	}
+
+private:
+	Disposer _disposer;
+
+	static void deleteArray(byte *data) {
+		delete[] data;
+	}
+};
+
+} // End of namespace Common
+
+#endif // COMMON_MEMREADSTREAM_H
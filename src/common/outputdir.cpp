@@ -0,0 +1,374 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/outputdir.cpp
+ *  Writing extracted files into a directory, each showing up only once complete.
+ */
+
+#include <cerrno>
+#include <cstdio>
+
+#include <atomic>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "common/util.h"
+#include "common/fileio.h"
+#include "common/outputdir.h"
+
+#ifndef O_BINARY
+	#define O_BINARY 0
+#endif
+
+namespace Common {
+
+static const uint32 kStreamBufferSize = 64 * 1024;
+
+/** Numbers the temporary files of this process. */
+static std::atomic<uint32> tempFileCounter(0);
+
+/** Is this a relative path that stays within the directory it's relative to? */
+static bool isSafeName(const std::string &name) {
+	if (name.empty() || (name[0] == '/'))
+		return false;
+
+	std::string::size_type start = 0;
+	while (start <= name.size()) {
+		std::string::size_type end = name.find('/', start);
+		if (end == std::string::npos)
+			end = name.size();
+
+		const std::string component = name.substr(start, end - start);
+		if (component.empty() || (component == ".") || (component == ".."))
+			return false;
+
+		start = end + 1;
+	}
+
+	return true;
+}
+
+/** Return the directory part of a relative path, "." if there is none. */
+static std::string getParentPath(const std::string &path) {
+	const std::string::size_type slash = path.find_last_of('/');
+
+	return (slash == std::string::npos) ? std::string(".") : path.substr(0, slash);
+}
+
+/** Return the name of a hidden temporary file in the same directory as a file. */
+static std::string getTempName(const std::string &path) {
+	const std::string::size_type slash = path.find_last_of('/');
+	const std::string::size_type base  = (slash == std::string::npos) ? 0 : (slash + 1);
+
+	char suffix[32];
+	std::snprintf(suffix, sizeof(suffix), ".%u.%u.part", (uint) getpid(), (uint) tempFileCounter++);
+
+	return path.substr(0, base) + "." + path.substr(base) + suffix;
+}
+
+
+OutputFile::OutputFile() : _dir(0), _fd(-1) {
+}
+
+OutputFile::~OutputFile() {
+	discard();
+}
+
+bool OutputFile::isOpen() const {
+	return _fd >= 0;
+}
+
+bool OutputFile::write(const byte *data, uint32 size) {
+	if (_fd < 0)
+		return false;
+
+	if (!writeData(_fd, data, size)) {
+		discard();
+		return false;
+	}
+
+	return true;
+}
+
+bool OutputFile::copyFrom(int in, uint32 offset, uint32 size) {
+	if (_fd < 0)
+		return false;
+
+	if (!copyDataAt(_fd, in, offset, size)) {
+		discard();
+		return false;
+	}
+
+	return true;
+}
+
+bool OutputFile::commit() {
+	if (_fd < 0)
+		return false;
+
+	bool success = true;
+
+#ifdef O_TMPFILE
+	if (_tempName.empty()) {
+		/* An anonymous file gets its name through /proc. linkat() never replaces
+		 * an existing file, so those are replaced by renaming, like temporary files. */
+		char procPath[64];
+		std::snprintf(procPath, sizeof(procPath), "/proc/self/fd/%d", _fd);
+
+		if (linkat(AT_FDCWD, procPath, _dir->_fd, _name.c_str(), AT_SYMLINK_FOLLOW) != 0) {
+			success = false;
+
+			if (errno == EEXIST) {
+				_tempName = getTempName(_name);
+
+				success = linkat(AT_FDCWD, procPath, _dir->_fd, _tempName.c_str(), AT_SYMLINK_FOLLOW) == 0;
+				if (!success)
+					_tempName.clear();
+			}
+		}
+	}
+#endif
+
+	if (success && !_tempName.empty())
+		success = _dir->renameFile(_tempName, _name);
+
+	if (success)
+		_tempName.clear();
+
+	discard();
+	return success;
+}
+
+void OutputFile::discard() {
+	if (_dir && !_tempName.empty())
+		_dir->removeFile(_tempName);
+
+	close();
+}
+
+void OutputFile::close() {
+	closeFile(_fd);
+
+	_fd  = -1;
+	_dir = 0;
+
+	_name.clear();
+	_tempName.clear();
+}
+
+
+OutputDirectory::OutputDirectory() : _fd(-1), _shards(0), _anonymous(false) {
+}
+
+OutputDirectory::~OutputDirectory() {
+	closeFile(_fd);
+}
+
+bool OutputDirectory::open(const std::string &path, uint32 shards) {
+	closeFile(_fd);
+
+	_fd = -1;
+	_path.clear();
+
+	_shards    = (shards > 1) ? MIN(shards, kMaxShards) : 0;
+	_anonymous = false;
+
+	if (path.empty() || !createDirectories(path))
+		return false;
+
+#ifdef UNIX
+	_fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY);
+	if (_fd < 0)
+		return false;
+#endif
+
+	_path = path;
+
+	for (uint32 i = 0; i < _shards; i++) {
+		char shard[16];
+		std::snprintf(shard, sizeof(shard), "%02x", i);
+
+		if (!makeDirectory(shard))
+			return false;
+	}
+
+#ifdef O_TMPFILE
+	// Anonymous files need support by the file system, and /proc to name them
+	int probe = openat(_fd, ".", O_TMPFILE | O_WRONLY, 0666);
+	if (probe >= 0) {
+		_anonymous = access("/proc/self/fd", X_OK) == 0;
+
+		closeFile(probe);
+	}
+#endif
+
+	return true;
+}
+
+bool OutputDirectory::isOpen() const {
+	return !_path.empty();
+}
+
+std::string OutputDirectory::getFullPath(const std::string &name) const {
+	return _path + "/" + name;
+}
+
+int OutputDirectory::openFile(const std::string &name, int flags) const {
+#ifdef UNIX
+	return openat(_fd, name.c_str(), flags, 0666);
+#else
+	return ::open(getFullPath(name).c_str(), flags, 0666);
+#endif
+}
+
+bool OutputDirectory::makeDirectory(const std::string &name) const {
+#ifdef UNIX
+	return (mkdirat(_fd, name.c_str(), 0755) == 0) || (errno == EEXIST);
+#else
+	return createDirectories(getFullPath(name));
+#endif
+}
+
+bool OutputDirectory::renameFile(const std::string &from, const std::string &to) const {
+#ifdef UNIX
+	return renameat(_fd, from.c_str(), _fd, to.c_str()) == 0;
+#else
+	// rename() doesn't replace existing files here
+	const std::string target = getFullPath(to);
+
+	std::remove(target.c_str());
+	return std::rename(getFullPath(from).c_str(), target.c_str()) == 0;
+#endif
+}
+
+void OutputDirectory::removeFile(const std::string &name) const {
+#ifdef UNIX
+	unlinkat(_fd, name.c_str(), 0);
+#else
+	std::remove(getFullPath(name).c_str());
+#endif
+}
+
+std::string OutputDirectory::getFilePath(const std::string &name) const {
+	if (_shards == 0)
+		return name;
+
+	const uint64 hash = hashFNV64((const byte *) name.c_str(), name.size());
+
+	char shard[16];
+	std::snprintf(shard, sizeof(shard), "%02x/", (uint) (hash % _shards));
+
+	return shard + name;
+}
+
+bool OutputDirectory::createParents(const std::string &path) const {
+	for (std::string::size_type slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1))
+		if (!makeDirectory(path.substr(0, slash)))
+			return false;
+
+	return true;
+}
+
+bool OutputDirectory::create(const std::string &name, OutputFile &file) const {
+	file.discard();
+
+	if (!isOpen() || !isSafeName(name))
+		return false;
+
+	const std::string path = getFilePath(name);
+
+	// The shards already exist, only directories within the name itself need creating
+	if ((name.find('/') != std::string::npos) && !createParents(path))
+		return false;
+
+	file._dir  = this;
+	file._name = path;
+
+#ifdef O_TMPFILE
+	if (_anonymous) {
+		file._fd = openat(_fd, getParentPath(path).c_str(), O_TMPFILE | O_WRONLY, 0666);
+		if (file._fd >= 0)
+			return true;
+	}
+#endif
+
+	file._tempName = getTempName(path);
+	file._fd       = openFile(file._tempName, O_WRONLY | O_CREAT | O_EXCL | O_BINARY);
+
+	if (file._fd < 0) {
+		// Don't remove a file of the same name that somebody else created
+		file._tempName.clear();
+
+		file.close();
+		return false;
+	}
+
+	return true;
+}
+
+bool OutputDirectory::writeFile(const std::string &name, const byte *data, uint32 size) const {
+	OutputFile file;
+
+	return create(name, file) && file.write(data, size) && file.commit();
+}
+
+bool OutputDirectory::writeFile(const std::string &name, std::istream &input, uint32 offset, uint32 size) const {
+	input.clear();
+	input.seekg(offset, std::ios_base::beg);
+
+	if (input.tellg() != offset)
+		return false;
+
+	OutputFile file;
+	if (!create(name, file))
+		return false;
+
+	byte buffer[kStreamBufferSize];
+	while (size > 0) {
+		const uint32 toRead = MIN(size, kStreamBufferSize);
+
+		input.read((char *) buffer, toRead);
+		if (((uint32) input.gcount() != toRead) || !file.write(buffer, toRead))
+			return false;
+
+		size -= toRead;
+	}
+
+	return file.commit();
+}
+
+bool OutputDirectory::copyFile(const std::string &name, int in, uint32 offset, uint32 size) const {
+	OutputFile file;
+
+	return create(name, file) && file.copyFrom(in, offset, size) && file.commit();
+}
+
+} // End of namespace Common
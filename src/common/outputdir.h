@@ -0,0 +1,157 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/outputdir.h
+ *  Writing extracted files into a directory, each showing up only once complete.
+ */
+
+#ifndef COMMON_OUTPUTDIR_H
+#define COMMON_OUTPUTDIR_H
+
+#include <string>
+#include <istream>
+
+#include "common/types.h"
+
+namespace Common {
+
+class OutputDirectory;
+
+/** A file being written into an OutputDirectory.
+ *
+ *  Until it's committed, the file is either an anonymous O_TMPFILE, or a
+ *  hidden temporary file next to where it should go. Either way, nothing
+ *  ever shows up under the file's name with only part of its data, not
+ *  even when the process is killed midway.
+ *
+ *  Files aren't synced to disk, though. After a system crash, a committed
+ *  file might still be empty or missing.
+ */
+class OutputFile {
+public:
+	OutputFile();
+	/** Throw the file away, unless it has been committed. */
+	~OutputFile();
+
+	bool isOpen() const;
+
+	/** Write data to the end of the file. On failure, the file is thrown away. */
+	bool write(const byte *data, uint32 size);
+	/** Copy data from an offset within another file, like copyDataAt(). On failure, the file is thrown away. */
+	bool copyFrom(int in, uint32 offset, uint32 size);
+
+	/** Make the file show up under its name, replacing any file already there. */
+	bool commit();
+	/** Throw the file away. */
+	void discard();
+
+private:
+	const OutputDirectory *_dir;
+
+	int _fd;
+
+	std::string _name;     ///< The name of the file, relative to the output directory.
+	std::string _tempName; ///< The temporary file, empty for an anonymous file.
+
+	// An open file has exactly one owner
+	OutputFile(const OutputFile &);
+	OutputFile &operator=(const OutputFile &);
+
+	void close();
+
+	friend class OutputDirectory;
+};
+
+/** A directory to extract files into.
+ *
+ *  All files are opened relative to a descriptor of the directory, so that
+ *  the path to the directory is only resolved once. Where there are no
+ *  openat() and friends, they're opened by their full path instead.
+ *  With sharding, the files
+ *  are spread over numbered subdirectories by the hash of their name, to
+ *  keep single directories small when extracting huge numbers of files.
+ */
+class OutputDirectory {
+public:
+	/** The most subdirectories to spread files over. */
+	static const uint32 kMaxShards = 256;
+
+	OutputDirectory();
+	~OutputDirectory();
+
+	/** Open the directory, creating it and the subdirectories for sharding if necessary.
+	 *
+	 *  @param  path   The directory.
+	 *  @param  shards The number of subdirectories to spread the files over, 0 for none.
+	 */
+	bool open(const std::string &path, uint32 shards = 0);
+
+	/** Return where a file goes, relative to the directory. */
+	std::string getFilePath(const std::string &name) const;
+
+	/** Start writing a file. Directories within the name are created as needed.
+	 *
+	 *  Names that are absolute, or contain empty, "." or ".." components, are refused.
+	 */
+	bool create(const std::string &name, OutputFile &file) const;
+
+	/** Write a whole file at once. */
+	bool writeFile(const std::string &name, const byte *data, uint32 size) const;
+	/** Write a whole file from a part of a stream. */
+	bool writeFile(const std::string &name, std::istream &input, uint32 offset, uint32 size) const;
+	/** Write a whole file from a part of another file, like copyDataAt(). */
+	bool copyFile(const std::string &name, int in, uint32 offset, uint32 size) const;
+
+private:
+	std::string _path;
+
+	int _fd;
+
+	uint32 _shards;
+
+	bool _anonymous; ///< Can files be created as anonymous O_TMPFILEs?
+
+	bool isOpen() const;
+
+	/** Return the path of a file within the directory, to open it without openat(). */
+	std::string getFullPath(const std::string &name) const;
+
+	int openFile(const std::string &name, int flags) const;
+	bool makeDirectory(const std::string &name) const;
+	bool renameFile(const std::string &from, const std::string &to) const;
+	void removeFile(const std::string &name) const;
+
+	bool createParents(const std::string &path) const;
+
+	friend class OutputFile;
+};
+
+} // End of namespace Common
+
+#endif // COMMON_OUTPUTDIR_H
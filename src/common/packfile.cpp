@@ -0,0 +1,529 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/packfile.cpp
+ *  A container of resources from many archives, made for mapping into memory.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+
+#include <unistd.h>
+
+#include "common/util.h"
+#include "common/fileio.h"
+#include "common/glue.h"
+#include "common/packfile.h"
+
+#ifdef HAVE_SYS_MMAN_H
+	#include <sys/mman.h>
+#endif
+
+namespace Common {
+
+static const char   kPackMagic[8]   = { 'D', 'S', '2', 'P', 'A', 'C', 'K', '1' };
+static const uint32 kPackHeaderSize = 32;
+static const uint32 kPackEntrySize  = 32;
+
+/** Member data starts on page boundaries. */
+static const uint32 kPackAlignment = 4096;
+
+static const uint32 kPackFlagCompressed = 0x00000001;
+
+/** How far uncompressing might write past the end of a member. */
+static const uint32 kUncompressSlack = 32;
+
+/** Uncompress the blocks of a member, until it has size bytes.
+ *
+ *  Unlike uncompressGlueChunk(), there's no window of zeros before the
+ *  output, so every match is checked against the data written so far.
+ *  The output buffer needs kUncompressSlack bytes beyond size.
+ */
+static bool uncompressMemberData(byte *outBuf, uint32 size, const byte *inBuf, uint32 n) {
+	const byte *inEnd = inBuf + n;
+
+	uint32 written = 0;
+	while ((written < size) && ((inEnd - inBuf) >= 17)) {
+		uint8 mask = *inBuf++;
+
+		for (int i = 0; (i < 8) && (written < size); i++, mask >>= 1, inBuf += 2) {
+			if (mask & 1) {
+				// Direct copy
+
+				outBuf[written++] = inBuf[0];
+				outBuf[written++] = inBuf[1];
+				continue;
+			}
+
+			// Copy from previous output
+
+			const uint16 token = readUint16LE(inBuf);
+
+			const uint32 offset = (token >> 4)  + 1;
+			const uint32 count  = (token & 0xF) + 3;
+
+			if (offset > written)
+				return false;
+
+			for (uint32 j = 0; j < count; j++, written++)
+				outBuf[written] = outBuf[written - offset];
+		}
+	}
+
+	return written >= size;
+}
+
+static uint64 hashName(const char *name) {
+	return hashFNV64((const byte *) name, strlen(name));
+}
+
+static uint32 getBucket(uint64 hash, uint32 bucketBits) {
+	return (bucketBits == 0) ? 0 : (uint32) (hash >> (64 - bucketBits));
+}
+
+static uint64 readHash(const byte *data) {
+	return ((uint64) readUint32LE(data + 4) << 32) | readUint32LE(data);
+}
+
+
+PackFile::PackFile() : _data(0), _size(0), _memberCount(0), _bucketBits(0), _buckets(0), _entries(0), _names(0) {
+}
+
+PackFile::~PackFile() {
+	close();
+}
+
+bool PackFile::open(const std::string &file) {
+	close();
+
+	int fd = openRead(file);
+	if (fd < 0)
+		return false;
+
+	const uint32 size = getFileSize(fd);
+	if ((size == 0xFFFFFFFF) || (size < kPackHeaderSize)) {
+		closeFile(fd);
+		return false;
+	}
+
+#ifdef HAVE_SYS_MMAN_H
+	void *mapping = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	closeFile(fd);
+	if (mapping == MAP_FAILED)
+		return false;
+#else
+	byte *mapping = new byte[size];
+
+	bool success = (read(fd, mapping, size) == (ssize_t) size);
+
+	closeFile(fd);
+	if (!success) {
+		delete[] mapping;
+		return false;
+	}
+#endif
+
+	_data = (byte *) mapping;
+	_size = size;
+
+	const uint32 memberCount = readUint32LE(_data +  8);
+	const uint32 bucketBits  = readUint32LE(_data + 12);
+	const uint32 tableOffset = readUint32LE(_data + 16);
+	const uint32 namesOffset = readUint32LE(_data + 20);
+
+	const uint64 tableSize = (((uint64) 1 << MIN<uint32>(bucketBits, 32)) + 1) * 4 + (uint64) memberCount * kPackEntrySize;
+
+	if (memcmp(_data, kPackMagic, 8) || (readUint32LE(_data + 24) != size) || (bucketBits > 31) ||
+	    ((tableOffset + tableSize) > namesOffset) || (namesOffset > size)) {
+		close();
+		return false;
+	}
+
+	_memberCount = memberCount;
+	_bucketBits  = bucketBits;
+
+	_buckets = _data + tableOffset;
+	_entries = _buckets + ((1 << bucketBits) + 1) * 4;
+	_names   = (const char *) _data + namesOffset;
+
+	// Every bucket has to point to a valid range of entries
+	const uint32 bucketCount = 1 << bucketBits;
+	for (uint32 i = 0; i < bucketCount; i++) {
+		if ((readUint32LE(_buckets + i * 4) > readUint32LE(_buckets + (i + 1) * 4))) {
+			close();
+			return false;
+		}
+	}
+
+	if ((readUint32LE(_buckets) != 0) || (readUint32LE(_buckets + bucketCount * 4) != memberCount)) {
+		close();
+		return false;
+	}
+
+	// All names have to be terminated
+	const uint32 namesSize = size - namesOffset;
+	if ((memberCount > 0) && ((namesSize == 0) || (_names[namesSize - 1] != '\0'))) {
+		close();
+		return false;
+	}
+
+	for (uint32 i = 0; i < memberCount; i++) {
+		const byte *entry = _entries + i * kPackEntrySize;
+
+		const uint32 nameOffset = readUint32LE(entry +  8);
+		const uint32 flags      = readUint32LE(entry + 12);
+		const uint32 offset     = readUint32LE(entry + 16);
+		const uint32 storedSize = readUint32LE(entry + 20);
+		const uint32 memberSize = readUint32LE(entry + 24);
+
+		bool valid = (nameOffset < namesSize) && (offset <= tableOffset) && (storedSize <= (tableOffset - offset));
+
+		// Compressed data is made of whole blocks, each at most 8 tokens of 18 bytes
+		if (flags & kPackFlagCompressed)
+			valid = valid && (storedSize > 0) && ((storedSize % 17) == 0) &&
+			        (memberSize <= ((uint64) (storedSize / 17) * 8 * 18));
+		else
+			valid = valid && (storedSize == memberSize);
+
+		if (!valid) {
+			close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void PackFile::close() {
+	if (_data) {
+#ifdef HAVE_SYS_MMAN_H
+		munmap(_data, _size);
+#else
+		delete[] _data;
+#endif
+	}
+
+	_data = 0;
+	_size = 0;
+
+	_memberCount = 0;
+	_bucketBits  = 0;
+
+	_buckets = 0;
+	_entries = 0;
+	_names   = 0;
+}
+
+uint32 PackFile::getMemberCount() const {
+	return _memberCount;
+}
+
+void PackFile::readMember(uint32 index, PackMember &member) const {
+	const byte *entry = _entries + index * kPackEntrySize;
+
+	member.name       = _names + readUint32LE(entry + 8);
+	member.compressed = (readUint32LE(entry + 12) & kPackFlagCompressed) != 0;
+	member.offset     = readUint32LE(entry + 16);
+	member.storedSize = readUint32LE(entry + 20);
+	member.size       = readUint32LE(entry + 24);
+}
+
+bool PackFile::getMember(uint32 index, PackMember &member) const {
+	if (index >= _memberCount)
+		return false;
+
+	readMember(index, member);
+	return true;
+}
+
+bool PackFile::findMember(const char *name, PackMember &member) const {
+	if (!_data)
+		return false;
+
+	const uint64 hash   = hashName(name);
+	const uint32 bucket = getBucket(hash, _bucketBits);
+
+	const uint32 first = readUint32LE(_buckets +  bucket      * 4);
+	const uint32 last  = readUint32LE(_buckets + (bucket + 1) * 4);
+
+	for (uint32 i = first; i < last; i++) {
+		const byte *entry = _entries + i * kPackEntrySize;
+
+		if ((readHash(entry) == hash) && !strcmp(_names + readUint32LE(entry + 8), name)) {
+			readMember(i, member);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+const byte *PackFile::getStoredData(const PackMember &member) const {
+	return _data + member.offset;
+}
+
+byte *PackFile::uncompressMember(const PackMember &member) const {
+	const byte *stored = getStoredData(member);
+
+	if (!member.compressed) {
+		if (member.storedSize != member.size)
+			return 0;
+
+		byte *data = new byte[member.size];
+
+		memcpy(data, stored, member.size);
+		return data;
+	}
+
+	// Can't be more than every token copying 18 bytes, which open() made sure of
+	if ((member.size > ((uint64) (member.storedSize / 17) * 8 * 18)) ||
+	    (member.size > (0xFFFFFFFF - kUncompressSlack)))
+		return 0;
+
+	byte *data = new byte[member.size + kUncompressSlack];
+
+	if (!uncompressMemberData(data, member.size, stored, member.storedSize)) {
+		delete[] data;
+		return 0;
+	}
+
+	return data;
+}
+
+
+bool PackWriter::Entry::operator<(const Entry &entry) const {
+	if (hash != entry.hash)
+		return hash < entry.hash;
+
+	return name < entry.name;
+}
+
+PackWriter::PackWriter() : _fd(-1), _offset(0) {
+}
+
+PackWriter::~PackWriter() {
+	discard();
+}
+
+void PackWriter::discard() {
+	if (_fd < 0)
+		return;
+
+	closeFile(_fd);
+	_fd = -1;
+
+	unlink(_tempFile.c_str());
+}
+
+bool PackWriter::create(const std::string &file) {
+	discard();
+
+	_entries.clear();
+	_names.clear();
+	_offset = kPackHeaderSize;
+
+	char suffix[32];
+	std::snprintf(suffix, sizeof(suffix), ".%u.tmp", (uint) getpid());
+
+	_file     = file;
+	_tempFile = file + suffix;
+
+	_fd = openWrite(_tempFile);
+	if (_fd < 0)
+		return false;
+
+	// Leave room for the header, written last
+	byte header[kPackHeaderSize];
+	memset(header, 0, kPackHeaderSize);
+
+	return writeData(_fd, header, kPackHeaderSize);
+}
+
+bool PackWriter::align() {
+	static const byte kZeros[kPackAlignment] = { 0 };
+
+	const uint32 padding = (kPackAlignment - (_offset % kPackAlignment)) % kPackAlignment;
+	if (((uint64) _offset + padding) > 0xFFFFFFFFULL)
+		return false;
+
+	if (!writeData(_fd, kZeros, padding))
+		return false;
+
+	_offset += padding;
+	return true;
+}
+
+bool PackWriter::hasMember(const std::string &name) const {
+	return _names.find(name) != _names.end();
+}
+
+bool PackWriter::addMember(const std::string &name, const byte *data, uint32 size, bool compress) {
+	if ((_fd < 0) || hasMember(name) || !align())
+		return false;
+
+	Entry entry;
+
+	entry.hash       = hashName(name.c_str());
+	entry.name       = name;
+	entry.offset     = _offset;
+	entry.storedSize = size;
+	entry.size       = size;
+	entry.compressed = false;
+
+	byte *compressed = 0;
+	if (compress && (size > 0)) {
+		compressed = new byte[getMaxCompressedGlueSize(size)];
+
+		const uint32 compressedSize = compressGlueData(data, size, compressed);
+		if (compressedSize < size) {
+			entry.storedSize = compressedSize;
+			entry.compressed = true;
+		}
+	}
+
+	bool success = ((uint64) _offset + entry.storedSize) <= 0xFFFFFFFFULL;
+	if (success)
+		success = writeData(_fd, entry.compressed ? compressed : data, entry.storedSize);
+
+	delete[] compressed;
+
+	if (!success)
+		return false;
+
+	_offset += entry.storedSize;
+	_entries.push_back(entry);
+	_names.insert(name);
+
+	return true;
+}
+
+bool PackWriter::finish() {
+	if (_fd < 0)
+		return false;
+
+	std::sort(_entries.begin(), _entries.end());
+
+	const uint32 memberCount = _entries.size();
+
+	uint32 bucketBits = 0;
+	while ((bucketBits < 31) && ((1U << bucketBits) < memberCount))
+		bucketBits++;
+
+	const uint32 bucketCount = 1 << bucketBits;
+
+	// Bucket table, entries and names, all in one go
+	std::vector<byte> table((bucketCount + 1) * 4 + memberCount * kPackEntrySize);
+
+	byte *entries = &table[0] + (bucketCount + 1) * 4;
+
+	uint32 bucket = 0;
+	std::string names;
+	for (uint32 i = 0; i < memberCount; i++) {
+		const Entry &e = _entries[i];
+
+		const uint32 entryBucket = getBucket(e.hash, bucketBits);
+		while (bucket <= entryBucket)
+			writeUint32LE(&table[0] + (bucket++) * 4, i);
+
+		byte *entry = entries + i * kPackEntrySize;
+
+		writeUint32LE(entry +  0, (uint32) (e.hash & 0xFFFFFFFF));
+		writeUint32LE(entry +  4, (uint32) (e.hash >> 32));
+		writeUint32LE(entry +  8, names.size());
+		writeUint32LE(entry + 12, e.compressed ? kPackFlagCompressed : 0);
+		writeUint32LE(entry + 16, e.offset);
+		writeUint32LE(entry + 20, e.storedSize);
+		writeUint32LE(entry + 24, e.size);
+		writeUint32LE(entry + 28, 0);
+
+		names += e.name;
+		names += '\0';
+	}
+
+	while (bucket <= bucketCount)
+		writeUint32LE(&table[0] + (bucket++) * 4, memberCount);
+
+	// Keep the table aligned for the 64-bit hashes
+	static const byte kZeros[8] = { 0 };
+	const uint32 padding = (8 - (_offset % 8)) % 8;
+
+	const uint32 tableOffset = _offset + padding;
+	const uint32 namesOffset = tableOffset + table.size();
+	const uint64 packSize    = (uint64) namesOffset + names.size();
+
+	byte header[kPackHeaderSize];
+
+	memcpy(header, kPackMagic, 8);
+	writeUint32LE(header +  8, memberCount);
+	writeUint32LE(header + 12, bucketBits);
+	writeUint32LE(header + 16, tableOffset);
+	writeUint32LE(header + 20, namesOffset);
+	writeUint32LE(header + 24, (uint32) packSize);
+	writeUint32LE(header + 28, kPackAlignment);
+
+	bool success = (packSize <= 0xFFFFFFFFULL) &&
+	               writeData(_fd, kZeros, padding) &&
+	               writeData(_fd, &table[0], table.size()) &&
+	               writeData(_fd, (const byte *) names.data(), names.size()) &&
+	               writeDataAt(_fd, header, kPackHeaderSize, 0) &&
+	               syncFile(_fd);
+
+	if (!success) {
+		discard();
+		return false;
+	}
+
+	closeFile(_fd);
+	_fd = -1;
+
+	if (std::rename(_tempFile.c_str(), _file.c_str()) != 0) {
+		unlink(_tempFile.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+uint32 PackWriter::getMemberCount() const {
+	return _entries.size();
+}
+
+uint32 PackWriter::getCompressedCount() const {
+	uint32 count = 0;
+	for (std::vector<Entry>::const_iterator e = _entries.begin(); e != _entries.end(); ++e)
+		if (e->compressed)
+			count++;
+
+	return count;
+}
+
+} // End of namespace Common
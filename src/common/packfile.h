@@ -0,0 +1,187 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/packfile.h
+ *  A container of resources from many archives, made for mapping into memory.
+ *
+ *  All fields are little endian. The container starts with a header:
+ *
+ *  - 8 bytes magic "DS2PACK1"
+ *  - uint32 number of members
+ *  - uint32 number of bits used for the hash buckets
+ *  - uint32 offset of the name table
+ *  - uint32 offset of the name strings
+ *  - uint32 size of the whole container
+ *  - uint32 alignment of the member data
+ *
+ *  The member data follows, each member starting on a page boundary.
+ *
+ *  The name table holds the index of the first entry of every hash bucket
+ *  plus one past the last, followed by one 32 byte entry per member, sorted
+ *  by the 64-bit FNV-1a hash of its name:
+ *
+ *  - uint64 hash of the name
+ *  - uint32 offset of the name within the name strings
+ *  - uint32 flags
+ *  - uint32 offset of the member data
+ *  - uint32 size of the stored data
+ *  - uint32 size of the member
+ *  - uint32 reserved
+ *
+ *  A member's bucket is the top bits of its hash, so each bucket is one
+ *  contiguous range of entries. Finding a member is a single probe into the
+ *  bucket table, followed by comparing the (usually single) entry there.
+ *
+ *  Compressed members use the token format of glue chunks, as produced by
+ *  compressGlueData().
+ */
+
+#ifndef COMMON_PACKFILE_H
+#define COMMON_PACKFILE_H
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "common/types.h"
+
+namespace Common {
+
+/** Information about a member of a pack file. */
+struct PackMember {
+	const char *name;
+
+	uint32 offset;     ///< Offset of the stored data.
+	uint32 storedSize; ///< Size of the stored data.
+	uint32 size;       ///< Size of the member, after uncompressing.
+
+	bool compressed;
+};
+
+/** Reading a pack file mapped into memory. */
+class PackFile {
+public:
+	PackFile();
+	~PackFile();
+
+	/** Open and map a pack file, checking the whole name table. */
+	bool open(const std::string &file);
+	void close();
+
+	uint32 getMemberCount() const;
+
+	/** Get a member by its index within the name table. */
+	bool getMember(uint32 index, PackMember &member) const;
+	/** Find a member by its name. */
+	bool findMember(const char *name, PackMember &member) const;
+
+	/** Return the stored, possibly compressed, data of a member. */
+	const byte *getStoredData(const PackMember &member) const;
+
+	/** Return the uncompressed data of a member in a new[] buffer. Returns 0 on failure. */
+	byte *uncompressMember(const PackMember &member) const;
+
+private:
+	byte  *_data;
+	uint32 _size;
+
+	uint32 _memberCount;
+	uint32 _bucketBits;
+
+	const byte *_buckets;
+	const byte *_entries;
+	const char *_names;
+
+	void readMember(uint32 index, PackMember &member) const;
+};
+
+/** Writing a pack file, one member after the other. */
+class PackWriter {
+public:
+	PackWriter();
+	~PackWriter();
+
+	/** Create a new pack file.
+	 *
+	 *  It is written under a temporary name, and only renamed into place by a
+	 *  successful finish(). Otherwise, the temporary file is removed again.
+	 */
+	bool create(const std::string &file);
+
+	/** Was a member of that name already written? */
+	bool hasMember(const std::string &name) const;
+
+	/** Write the next member. Names have to be unique.
+	 *
+	 *  @param  name     The name of the member.
+	 *  @param  data     The data of the member.
+	 *  @param  size     The size of the data.
+	 *  @param  compress Compress the member, if that makes it smaller.
+	 *  @return false on write errors.
+	 */
+	bool addMember(const std::string &name, const byte *data, uint32 size, bool compress);
+
+	/** Write the name table and the header, and put the pack file into place. */
+	bool finish();
+
+	uint32 getMemberCount() const;
+	uint32 getCompressedCount() const;
+
+private:
+	struct Entry {
+		uint64 hash;
+		std::string name;
+
+		uint32 offset;
+		uint32 storedSize;
+		uint32 size;
+
+		bool compressed;
+
+		bool operator<(const Entry &entry) const;
+	};
+
+	std::string _file;
+	std::string _tempFile;
+
+	int _fd;
+	uint32 _offset;
+
+	std::vector<Entry> _entries;
+	std::set<std::string> _names;
+
+	bool align();
+
+	/** Close and remove an unfinished pack file. */
+	void discard();
+};
+
+} // End of namespace Common
+
+#endif // COMMON_PACKFILE_H
@@ -0,0 +1,130 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/pipestream.cpp
+ *  Reading a pipe, or any other file that can't seek, as an std::istream.
+ */
+
+#include <cerrno>
+
+#include <unistd.h>
+
+#include "common/fileio.h"
+#include "common/pipestream.h"
+
+namespace Common {
+
+/** Size of the read buffer, and so of the window that can be seeked back in. */
+static const uint32 kPipeBufferSize = 64 * 1024;
+
+PipeReadStream::StreamBuf::StreamBuf(int fd, bool dispose) : _fd(fd), _dispose(dispose),
+	_buffer(kPipeBufferSize), _bufferStart(0) {
+
+	setg(&_buffer[0], &_buffer[0], &_buffer[0]);
+}
+
+PipeReadStream::StreamBuf::~StreamBuf() {
+	if (_dispose)
+		closeFile(_fd);
+}
+
+PipeReadStream::StreamBuf::int_type PipeReadStream::StreamBuf::underflow() {
+	if (gptr() < egptr())
+		return traits_type::to_int_type(*gptr());
+
+	// Keep filling up the buffer, and only start over when it's full
+	uint32 used = egptr() - eback();
+	if (used == _buffer.size()) {
+		_bufferStart += used;
+		used = 0;
+
+		setg(&_buffer[0], &_buffer[0], &_buffer[0]);
+	}
+
+	ssize_t n;
+	while (((n = ::read(_fd, &_buffer[used], _buffer.size() - used)) < 0) && (errno == EINTR))
+		;
+
+	if (n <= 0)
+		return traits_type::eof();
+
+	setg(&_buffer[0], &_buffer[used], &_buffer[used + n]);
+	return traits_type::to_int_type(*gptr());
+}
+
+PipeReadStream::StreamBuf::pos_type PipeReadStream::StreamBuf::seekTo(uint64 position) {
+	if (position < _bufferStart)
+		return pos_type(off_type(-1));
+
+	// Skip forward
+	while (position > (_bufferStart + (egptr() - eback()))) {
+		setg(eback(), egptr(), egptr());
+
+		if (traits_type::eq_int_type(underflow(), traits_type::eof()))
+			return pos_type(off_type(-1));
+	}
+
+	setg(eback(), eback() + (position - _bufferStart), egptr());
+	return pos_type(off_type(position));
+}
+
+PipeReadStream::StreamBuf::pos_type PipeReadStream::StreamBuf::seekoff(off_type off, std::ios_base::seekdir way,
+                                                                       std::ios_base::openmode which) {
+	if (!(which & std::ios_base::in))
+		return pos_type(off_type(-1));
+
+	const int64 current = _bufferStart + (gptr() - eback());
+
+	int64 position;
+	if      (way == std::ios_base::beg)
+		position = off;
+	else if (way == std::ios_base::cur)
+		position = current + off;
+	else
+		return pos_type(off_type(-1));
+
+	if (position < 0)
+		return pos_type(off_type(-1));
+
+	return seekTo(position);
+}
+
+PipeReadStream::StreamBuf::pos_type PipeReadStream::StreamBuf::seekpos(pos_type sp, std::ios_base::openmode which) {
+	return seekoff(off_type(sp), std::ios_base::beg, which);
+}
+
+
+PipeReadStream::PipeReadStream(int fd, bool dispose) : std::istream(0), _streamBuf(fd, dispose) {
+	rdbuf(&_streamBuf);
+}
+
+PipeReadStream::~PipeReadStream() {
+}
+
+} // End of namespace Common
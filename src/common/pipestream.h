@@ -0,0 +1,88 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/pipestream.h
+ *  Reading a pipe, or any other file that can't seek, as an std::istream.
+ */
+
+#ifndef COMMON_PIPESTREAM_H
+#define COMMON_PIPESTREAM_H
+
+#include <istream>
+#include <streambuf>
+#include <vector>
+
+#include "common/types.h"
+
+namespace Common {
+
+/** A stream over a file descriptor that can only be read front to back.
+ *
+ *  Seeking forward skips over the data in between. Seeking backward only
+ *  works within the last buffer full of data, which always includes the
+ *  start of the file until more than a buffer full was read. This is enough
+ *  to peek at the header of a file and then start over. Seeking relative
+ *  to the end of the file always fails, so getSize() fails too.
+ */
+class PipeReadStream : public std::istream {
+private:
+	class StreamBuf : public std::streambuf {
+	public:
+		StreamBuf(int fd, bool dispose);
+		~StreamBuf();
+
+	protected:
+		int_type underflow();
+
+		pos_type seekoff(off_type off, std::ios_base::seekdir way, std::ios_base::openmode which);
+		pos_type seekpos(pos_type sp, std::ios_base::openmode which);
+
+	private:
+		int  _fd;
+		bool _dispose;
+
+		std::vector<char> _buffer;
+		uint64 _bufferStart; ///< Position of the start of the buffer within the file.
+
+		pos_type seekTo(uint64 position);
+	};
+
+	StreamBuf _streamBuf;
+
+public:
+	/** @param fd      The file descriptor to read from.
+	 *  @param dispose Close the file descriptor when done.
+	 */
+	PipeReadStream(int fd, bool dispose);
+	~PipeReadStream();
+};
+
+} // End of namespace Common
+
+#endif // COMMON_PIPESTREAM_H
@@ -0,0 +1,221 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/progress.cpp
+ *  Reporting the progress of an extraction, formatted on a background thread.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdarg>
+
+#include <chrono>
+
+#include "common/util.h"
+#include "common/trace.h"
+#include "common/progress.h"
+
+namespace Common {
+
+/** How many events can be waiting to be formatted. */
+static const uint32 kEventQueueSize = 4096;
+
+/** Formatted output is written once it has grown this big, or once no events are waiting. */
+static const uint32 kMaxBatchSize = 64 * 1024;
+
+/** The progress bar is redrawn at most this often, in ms. */
+static const uint64 kBarInterval = 100;
+/** The width of the progress bar, in characters. */
+static const uint32 kBarWidth    = 30;
+
+static const char *kModeNames[kProgressMAX] = { "quiet", "summary", "bar", "full" };
+
+static uint64 getMilliseconds() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void appendFormat(std::string &out, const char *format, ...) {
+	char buffer[256];
+
+	va_list args;
+	va_start(args, format);
+	const int length = vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+
+	if (length > 0)
+		out.append(buffer, MIN<uint32>(length, sizeof(buffer) - 1));
+}
+
+static void writeOutput(std::string &out) {
+	if (out.empty())
+		return;
+
+	std::fwrite(out.c_str(), 1, out.size(), stdout);
+	std::fflush(stdout);
+
+	out.clear();
+}
+
+ProgressReporter::ProgressReporter(ProgressMode mode) : _mode(mode), _events(kEventQueueSize), _started(false),
+	_fileCount(0), _doneCount(0), _failedCount(0), _doneSize(0), _lastDraw(0), _barVisible(false) {
+}
+
+ProgressReporter::~ProgressReporter() {
+	finish();
+}
+
+bool ProgressReporter::parseMode(const char *name, ProgressMode &mode) {
+	for (int i = 0; i < kProgressMAX; i++) {
+		if (!strcmp(name, kModeNames[i])) {
+			mode = (ProgressMode) i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ProgressReporter::start(uint32 fileCount) {
+	if (_started)
+		return;
+
+	_fileCount = fileCount;
+	_started   = true;
+
+	_thread = std::thread(&ProgressReporter::run, this);
+}
+
+void ProgressReporter::reportFile(uint32 index, const char *name, uint32 size, bool success) {
+	Event event;
+
+	event.index   = index;
+	event.size    = size;
+	event.success = success;
+
+	strncpy(event.name, name, 12);
+	event.name[12] = '\0';
+
+	_events.push(event);
+}
+
+void ProgressReporter::finish() {
+	if (!_started)
+		return;
+
+	_events.close();
+	_thread.join();
+
+	_started = false;
+}
+
+void ProgressReporter::run() {
+	setTraceThreadName("progress");
+
+	std::string out;
+
+	if (_mode == kProgressFull)
+		appendFormat(out, "Number of files: %u\n\n", _fileCount);
+
+	Event event;
+	while (_events.pop(event)) {
+		formatEvent(event, out);
+
+		// Take everything else that's waiting, and write it all at once
+		while ((out.size() < kMaxBatchSize) && _events.tryPop(event))
+			formatEvent(event, out);
+
+		if (_mode == kProgressBar) {
+			const uint64 now = getMilliseconds();
+			if ((now - _lastDraw) >= kBarInterval) {
+				formatBar(out);
+
+				_lastDraw = now;
+			}
+		}
+
+		writeOutput(out);
+	}
+
+	if (_mode == kProgressBar) {
+		formatBar(out);
+		out += '\n';
+	}
+
+	if ((_mode == kProgressSummary) || (_mode == kProgressBar))
+		formatSummary(out);
+
+	writeOutput(out);
+}
+
+void ProgressReporter::formatEvent(const Event &event, std::string &out) {
+	_doneCount++;
+
+	if (event.success)
+		_doneSize += event.size;
+	else
+		_failedCount++;
+
+	if (event.success && (_mode != kProgressFull))
+		return;
+
+	// Failures get a line of their own, below the progress bar
+	if (_barVisible) {
+		out += '\n';
+
+		_barVisible = false;
+	}
+
+	appendFormat(out, "Extracting %u/%u: \"%s\"... %s\n", event.index + 1, _fileCount, event.name,
+	             event.success ? "done" : "FAILED");
+}
+
+void ProgressReporter::formatBar(std::string &out) {
+	const uint32 filled = (_fileCount == 0) ? kBarWidth : ((uint64) _doneCount * kBarWidth / _fileCount);
+	const uint32 percent = (_fileCount == 0) ? 100 : ((uint64) _doneCount * 100 / _fileCount);
+
+	out += "\r[";
+	out.append(filled, '#');
+	out.append(kBarWidth - filled, ' ');
+
+	appendFormat(out, "] %3u%%  %u/%u files, %.1f MiB", percent, _doneCount, _fileCount,
+	             _doneSize / (1024.0 * 1024.0));
+
+	_barVisible = true;
+}
+
+void ProgressReporter::formatSummary(std::string &out) {
+	appendFormat(out, "Extracted %u of %u files, %.1f MiB\n", _doneCount - _failedCount, _fileCount,
+	             _doneSize / (1024.0 * 1024.0));
+
+	if (_failedCount > 0)
+		appendFormat(out, "%u files FAILED\n", _failedCount);
+}
+
+} // End of namespace Common
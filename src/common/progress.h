@@ -0,0 +1,126 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/progress.h
+ *  Reporting the progress of an extraction, formatted on a background thread.
+ */
+
+#ifndef COMMON_PROGRESS_H
+#define COMMON_PROGRESS_H
+
+#include <string>
+#include <thread>
+
+#include "common/types.h"
+#include "common/spscqueue.h"
+
+namespace Common {
+
+/** How much to report about an extraction. */
+enum ProgressMode {
+	kProgressQuiet   , ///< Only files that failed.
+	kProgressSummary , ///< Failed files, and a summary at the end.
+	kProgressBar     , ///< A progress bar, redrawn a few times a second, and a summary.
+	kProgressFull    , ///< A line for every file.
+	kProgressMAX
+};
+
+/** Reports the progress of an extraction.
+ *
+ *  Reporting only pushes an event into a lock-free queue. A background
+ *  thread formats the events and writes them to stdout in batches, so
+ *  extracting never waits for a slow terminal or log pipe, except when
+ *  the queue is full.
+ *
+ *  Only one thread can report at a time. Reporting can move to another
+ *  thread, if that's otherwise synchronized with the previous one, for
+ *  example by handing over work through a queue.
+ */
+class ProgressReporter {
+public:
+	ProgressReporter(ProgressMode mode);
+	~ProgressReporter();
+
+	/** Start reporting on an extraction of this many files. */
+	void start(uint32 fileCount);
+
+	/** Report that a file has been extracted.
+	 *
+	 *  @param  index   The index of the file, counting from 0.
+	 *  @param  name    The name of the file.
+	 *  @param  size    The size of the file.
+	 *  @param  success Has the file been extracted successfully?
+	 */
+	void reportFile(uint32 index, const char *name, uint32 size, bool success);
+
+	/** Wait until everything has been written, and write the summary. */
+	void finish();
+
+	/** Parse the name of a mode, as given on the command line. */
+	static bool parseMode(const char *name, ProgressMode &mode);
+
+private:
+	struct Event {
+		uint32 index;
+		uint32 size;
+		bool success;
+
+		char name[13];
+	};
+
+	ProgressMode _mode;
+
+	SPSCQueue<Event> _events;
+	std::thread _thread;
+
+	bool _started;
+
+	// Only touched by the background thread, until it's finished
+	uint32 _fileCount;
+	uint32 _doneCount;
+	uint32 _failedCount;
+	uint64 _doneSize;
+
+	uint64 _lastDraw;    ///< When the progress bar was last drawn, in ms.
+	bool   _barVisible;  ///< Is the progress bar the last thing on the line?
+
+	void run();
+
+	void formatEvent(const Event &event, std::string &out);
+	void formatBar(std::string &out);
+	void formatSummary(std::string &out);
+
+	// Not copyable
+	ProgressReporter(const ProgressReporter &);
+	ProgressReporter &operator=(const ProgressReporter &);
+};
+
+} // End of namespace Common
+
+#endif // COMMON_PROGRESS_H
@@ -0,0 +1,190 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/spscqueue.h
+ *  A bounded, lock-free single-producer/single-consumer queue.
+ */
+
+#ifndef COMMON_SPSCQUEUE_H
+#define COMMON_SPSCQUEUE_H
+
+#include <chrono>
+
+#include <atomic>
+#include <thread>
+
+#include "common/types.h"
+
+namespace Common {
+
+/** Statistics about how a queue has been used. */
+struct QueueStats {
+	uint64 items;        ///< Number of items that went through the queue.
+	uint64 occupancySum; ///< Sum of the queue fill levels seen by each push.
+	uint64 fullWaits;    ///< Number of times the producer had to wait for space.
+	uint64 emptyWaits;   ///< Number of times the consumer had to wait for items.
+
+	QueueStats() : items(0), occupancySum(0), fullWaits(0), emptyWaits(0) {
+	}
+
+	double getAverageOccupancy() const {
+		return (items == 0) ? 0.0 : ((double) occupancySum / items);
+	}
+};
+
+/** A bounded, lock-free queue between exactly one producer and one consumer thread.
+ *
+ *  When the queue is full or empty, the waiting side first spins briefly and
+ *  then sleeps in short intervals, so a stalled stage doesn't burn a CPU.
+ */
+template<typename T>
+class SPSCQueue {
+public:
+	/** Create a queue holding capacity items, rounded up to a power of two. */
+	SPSCQueue(uint32 capacity) : _head(0), _tail(0), _closed(false), _consumerEmptyWaits(0) {
+		_capacity = 1;
+		while (_capacity < capacity)
+			_capacity <<= 1;
+
+		_items = new T[_capacity];
+	}
+
+	~SPSCQueue() {
+		delete[] _items;
+	}
+
+	uint32 getCapacity() const {
+		return _capacity;
+	}
+
+	/** Add an item, waiting for space if necessary. Producer only. */
+	void push(const T &item) {
+		const uint32 tail = _tail.load(std::memory_order_relaxed);
+
+		uint32 head = _head.load(std::memory_order_acquire);
+		if ((tail - head) == _capacity) {
+			_stats.fullWaits++;
+
+			for (uint32 spins = 0; (tail - (head = _head.load(std::memory_order_acquire))) == _capacity; spins++)
+				backOff(spins);
+		}
+
+		_items[tail & (_capacity - 1)] = item;
+
+		_stats.items++;
+		_stats.occupancySum += tail - head + 1;
+
+		_tail.store(tail + 1, std::memory_order_release);
+	}
+
+	/** Remove an item, waiting for one if necessary. Consumer only.
+	 *
+	 *  @return false if the queue has been closed and is empty.
+	 */
+	bool pop(T &item) {
+		const uint32 head = _head.load(std::memory_order_relaxed);
+
+		if (_tail.load(std::memory_order_acquire) == head) {
+			_consumerEmptyWaits++;
+
+			for (uint32 spins = 0; _tail.load(std::memory_order_acquire) == head; spins++) {
+				if (_closed.load(std::memory_order_acquire)) {
+					// Re-check: the producer might have pushed right before closing
+					if (_tail.load(std::memory_order_acquire) == head)
+						return false;
+
+					break;
+				}
+
+				backOff(spins);
+			}
+		}
+
+		item = _items[head & (_capacity - 1)];
+
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	/** Remove an item if there is one, without waiting. Consumer only. */
+	bool tryPop(T &item) {
+		const uint32 head = _head.load(std::memory_order_relaxed);
+
+		if (_tail.load(std::memory_order_acquire) == head)
+			return false;
+
+		item = _items[head & (_capacity - 1)];
+
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	/** Signal that no more items will be pushed. Producer only. */
+	void close() {
+		_closed.store(true, std::memory_order_release);
+	}
+
+	/** Return the statistics of this queue. Only valid once both sides are done. */
+	QueueStats getStats() const {
+		QueueStats stats = _stats;
+
+		stats.emptyWaits = _consumerEmptyWaits;
+		return stats;
+	}
+
+private:
+	uint32 _capacity;
+	T *_items;
+
+	// Keep the producer's and the consumer's data on separate cache lines
+	alignas(64) std::atomic<uint32> _head;
+	alignas(64) std::atomic<uint32> _tail;
+
+	std::atomic<bool> _closed;
+
+	QueueStats _stats;         ///< Producer-side statistics.
+	alignas(64) uint64 _consumerEmptyWaits; ///< Consumer-side statistics.
+
+	static void backOff(uint32 spins) {
+		if (spins < 64) {
+			std::this_thread::yield();
+			return;
+		}
+
+		std::this_thread::sleep_for(std::chrono::microseconds(50));
+	}
+
+	// Not copyable
+	SPSCQueue(const SPSCQueue &);
+	SPSCQueue &operator=(const SPSCQueue &);
+};
+
+} // End of namespace Common
+
+#endif // COMMON_SPSCQUEUE_H
@@ -0,0 +1,234 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/trace.cpp
+ *  Recording timed spans, written out as a Chrome trace.
+ */
+
+#include <cstdio>
+
+#include <vector>
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#include <unistd.h>
+
+#include "common/trace.h"
+
+namespace Common {
+
+struct TraceEvent {
+	const char *name;
+	std::string detail;
+
+	uint64 start;
+	uint64 duration;
+	uint64 bytes;
+};
+
+/** The spans recorded by one thread.
+ *
+ *  Only ever contended when the trace is finished while the thread still
+ *  records. The buffers live as long as the process, so that a thread never
+ *  finds its buffer gone.
+ */
+struct ThreadTrace {
+	uint32 id;
+	std::string name;
+
+	std::mutex mutex;
+	std::vector<TraceEvent> events;
+};
+
+typedef std::chrono::steady_clock TraceClock;
+
+/** Set after traceStart, so that threads seeing it set also see the start time. */
+static std::atomic<bool> tracing(false);
+static TraceClock::time_point traceStart;
+
+/** Every thread's buffer. Locked when a thread records its first span, and by finishTrace(). */
+static std::mutex threadsMutex;
+static std::list<ThreadTrace *> threads;
+
+static thread_local ThreadTrace *threadTrace = 0;
+
+static ThreadTrace &getThreadTrace() {
+	if (threadTrace)
+		return *threadTrace;
+
+	threadTrace = new ThreadTrace;
+	threadTrace->events.reserve(4096);
+
+	std::lock_guard<std::mutex> lock(threadsMutex);
+
+	threadTrace->id = threads.size() + 1;
+	threads.push_back(threadTrace);
+
+	return *threadTrace;
+}
+
+void startTrace() {
+	traceStart = TraceClock::now();
+	tracing.store(true, std::memory_order_release);
+}
+
+bool isTracing() {
+	return tracing.load(std::memory_order_acquire);
+}
+
+uint64 getTraceTime() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(TraceClock::now() - traceStart).count() + 1;
+}
+
+void setTraceThreadName(const char *name) {
+	if (!isTracing())
+		return;
+
+	ThreadTrace &thread = getThreadTrace();
+
+	std::lock_guard<std::mutex> lock(thread.mutex);
+	thread.name = name;
+}
+
+void recordTraceSpan(const char *name, const char *detail, uint64 start, uint64 bytes) {
+	if (!isTracing())
+		return;
+
+	ThreadTrace &thread = getThreadTrace();
+
+	std::lock_guard<std::mutex> lock(thread.mutex);
+
+	// Spans still open when the trace was finished are dropped
+	if (!isTracing())
+		return;
+
+	thread.events.push_back(TraceEvent());
+
+	TraceEvent &event = thread.events.back();
+
+	event.name     = name;
+	event.start    = start;
+	event.duration = getTraceTime() - start;
+	event.bytes    = bytes;
+
+	if (detail)
+		event.detail = detail;
+}
+
+static void writeJSONString(FILE *file, const std::string &str) {
+	std::fputc('"', file);
+
+	for (std::string::const_iterator c = str.begin(); c != str.end(); ++c) {
+		if      ((*c == '"') || (*c == '\\'))
+			std::fprintf(file, "\\%c", *c);
+		else if ((unsigned char) *c < 0x20)
+			std::fprintf(file, "\\u%04x", (uint) (unsigned char) *c);
+		else
+			std::fputc(*c, file);
+	}
+
+	std::fputc('"', file);
+}
+
+/** Write a time in nanoseconds as the microseconds the trace format wants. */
+static void writeJSONTime(FILE *file, uint64 time) {
+	std::fprintf(file, "%llu.%03u", (unsigned long long) (time / 1000), (uint) (time % 1000));
+}
+
+static void writeTrace(FILE *file) {
+	const uint pid = getpid();
+
+	std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	std::lock_guard<std::mutex> threadsLock(threadsMutex);
+
+	bool first = true;
+	for (std::list<ThreadTrace *>::const_iterator t = threads.begin(); t != threads.end(); ++t) {
+		std::lock_guard<std::mutex> lock((*t)->mutex);
+
+		if (!(*t)->name.empty()) {
+			std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":",
+			             first ? "" : ",\n", pid, (*t)->id);
+			writeJSONString(file, (*t)->name);
+			std::fprintf(file, "}}");
+
+			first = false;
+		}
+
+		for (std::vector<TraceEvent>::const_iterator e = (*t)->events.begin(); e != (*t)->events.end(); ++e) {
+			std::fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"ds2\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":",
+			             first ? "" : ",\n", e->name, pid, (*t)->id);
+			writeJSONTime(file, e->start - 1);
+			std::fprintf(file, ",\"dur\":");
+			writeJSONTime(file, e->duration);
+			std::fprintf(file, ",\"args\":{\"bytes\":%llu", (unsigned long long) e->bytes);
+
+			if (!e->detail.empty()) {
+				std::fprintf(file, ",\"file\":");
+				writeJSONString(file, e->detail);
+			}
+
+			std::fprintf(file, "}}");
+
+			first = false;
+		}
+	}
+
+	std::fprintf(file, "\n]}\n");
+}
+
+bool finishTrace(const std::string &file) {
+	if (!tracing.exchange(false))
+		return true;
+
+	bool success = false;
+
+	FILE *traceFile = std::fopen(file.c_str(), "w");
+	if (traceFile) {
+		writeTrace(traceFile);
+
+		success = !std::ferror(traceFile);
+		success = (std::fclose(traceFile) == 0) && success;
+	}
+
+	// Other threads might still hold on to their buffers, so only empty them
+	std::lock_guard<std::mutex> threadsLock(threadsMutex);
+
+	for (std::list<ThreadTrace *>::iterator t = threads.begin(); t != threads.end(); ++t) {
+		std::lock_guard<std::mutex> lock((*t)->mutex);
+
+		std::vector<TraceEvent>().swap((*t)->events);
+	}
+
+	return success;
+}
+
+} // End of namespace Common
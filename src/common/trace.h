@@ -0,0 +1,105 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file common/trace.h
+ *  Recording timed spans, written out as a Chrome trace.
+ */
+
+#ifndef COMMON_TRACE_H
+#define COMMON_TRACE_H
+
+#include <string>
+
+#include "common/types.h"
+
+namespace Common {
+
+/** Start recording spans. Needs to be called before any other threads are started. */
+void startTrace();
+
+/** Is a trace being recorded? */
+bool isTracing();
+
+/** Name the calling thread within the trace. */
+void setTraceThreadName(const char *name);
+
+/** Stop recording and write all spans as Chrome/Perfetto trace-event JSON.
+ *
+ *  Other threads may still be running. Spans they end afterwards, and spans
+ *  still open, are dropped.
+ */
+bool finishTrace(const std::string &file);
+
+/** Nanoseconds since the start of the trace; never 0. */
+uint64 getTraceTime();
+
+/** Record a finished span into the calling thread's buffer. */
+void recordTraceSpan(const char *name, const char *detail, uint64 start, uint64 bytes);
+
+/** A span lasting from construction to destruction.
+ *
+ *  Each thread records into its own buffer, under a lock nobody else takes
+ *  while the trace is running. Without a trace running, a span costs a
+ *  single check.
+ */
+class TraceSpan {
+public:
+	/** @param name   A static string naming the span.
+	 *  @param detail An optional string further describing the span, copied when the span ends.
+	 */
+	TraceSpan(const char *name, const char *detail = 0) : _name(name), _detail(detail), _start(0), _bytes(0) {
+		if (isTracing())
+			_start = getTraceTime();
+	}
+
+	~TraceSpan() {
+		if (_start != 0)
+			recordTraceSpan(_name, _detail, _start, _bytes);
+	}
+
+	/** Set the number of bytes handled within the span. */
+	void setBytes(uint64 bytes) {
+		_bytes = bytes;
+	}
+
+private:
+	const char *_name;
+	const char *_detail;
+
+	uint64 _start;
+	uint64 _bytes;
+
+	// Spans are bound to a scope
+	TraceSpan(const TraceSpan &);
+	TraceSpan &operator=(const TraceSpan &);
+};
+
+} // End of namespace Common
+
+#endif // COMMON_TRACE_H
@@ -31,8 +31,6 @@
  *  Common utility functions and macros.
  */
 
-#include <fstream>
-
 #include "common/util.h"
 
 namespace Common {
@@ -107,36 +105,83 @@ uint32 readUint32LE(const byte *data) {
 	return (uint32) (u4 << 24) | (u3 << 16) | (u2 << 8) | u1;
 }
 
+void writeUint16BE(byte *data, uint16 x) {
+	data[0] = (x >> 8) & 0xFF;
+	data[1] =  x       & 0xFF;
+}
+
+void writeUint16LE(byte *data, uint16 x) {
+	data[0] =  x       & 0xFF;
+	data[1] = (x >> 8) & 0xFF;
+}
+
+void writeUint32BE(byte *data, uint32 x) {
+	data[0] = (x >> 24) & 0xFF;
+	data[1] = (x >> 16) & 0xFF;
+	data[2] = (x >>  8) & 0xFF;
+	data[3] =  x        & 0xFF;
+}
+
+void writeUint32LE(byte *data, uint32 x) {
+	data[0] =  x        & 0xFF;
+	data[1] = (x >>  8) & 0xFF;
+	data[2] = (x >> 16) & 0xFF;
+	data[3] = (x >> 24) & 0xFF;
+}
+
 void readFixedString(std::istream &stream, char *str, int n) {
 	stream.read(str, n);
 	str[n] = '\0';
 }
 
-bool dumpToFile(std::istream &input, uint32 offset, uint32 size, const std::string &output) {
-	input.seekg(offset, std::ios_base::beg);
-
-	if (input.tellg() != offset)
-		return false;
+uint64 hashFNV64(const byte *data, uint32 size, uint64 hash) {
+	while (size-- > 0) {
+		hash ^= *data++;
+		hash *= 0x00000100000001B3ULL;
+	}
 
-	std::ofstream outFile;
+	return hash;
+}
 
-	outFile.open(output.c_str());
-	if (!outFile.is_open())
-		return false;
+static inline uint64 readHashWord(const byte *data) {
+	return  (uint64) data[0]        | ((uint64) data[1] <<  8) | ((uint64) data[2] << 16) | ((uint64) data[3] << 24) |
+	       ((uint64) data[4] << 32) | ((uint64) data[5] << 40) | ((uint64) data[6] << 48) | ((uint64) data[7] << 56);
+}
 
-	char buffer[4096];
-	while (size > 0) {
-		uint32 toRead = MIN<uint32>(size, 4096);
+static inline uint64 mixHashWord(uint64 hash, uint64 word) {
+	hash ^= word * 0x87C37B91114253D5ULL;
+	hash  = (hash << 31) | (hash >> 33);
 
-		input.read(buffer, toRead);
-		outFile.write(buffer, toRead);
+	return hash * 0x9E3779B97F4A7C15ULL;
+}
 
-		size -= toRead;
+uint64 hashData64(const byte *data, uint32 size) {
+	// Four independent lanes, so that the multiplications can overlap
+	uint64 lanes[4] = {
+		0x9E3779B97F4A7C15ULL ^ size, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL, 0x27D4EB2F165667C5ULL
+	};
+
+	for (; size >= 32; size -= 32, data += 32) {
+		lanes[0] = mixHashWord(lanes[0], readHashWord(data     ));
+		lanes[1] = mixHashWord(lanes[1], readHashWord(data +  8));
+		lanes[2] = mixHashWord(lanes[2], readHashWord(data + 16));
+		lanes[3] = mixHashWord(lanes[3], readHashWord(data + 24));
 	}
 
-	outFile.flush();
+	uint64 hash = lanes[0] ^ ((lanes[1] << 17) | (lanes[1] >> 47)) ^
+	              ((lanes[2] << 34) | (lanes[2] >> 30)) ^ ((lanes[3] << 51) | (lanes[3] >> 13));
+
+	for (; size >= 8; size -= 8, data += 8)
+		hash = mixHashWord(hash, readHashWord(data));
+
+	// Finish with the remaining bytes, and a final avalanche
+	hash = hashFNV64(data, size, hash);
+
+	hash ^= hash >> 33;
+	hash *= 0xFF51AFD7ED558CCDULL;
+	hash ^= hash >> 33;
 
-	return input.good() && outFile.good();
+	return hash;
 }
 
 uint32 getSize(std::istream &stream) {
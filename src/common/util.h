@@ -68,9 +68,22 @@ uint16 readUint16LE(const byte *data);
 uint32 readUint32BE(const byte *data);
 uint32 readUint32LE(const byte *data);
 
+void writeUint16BE(byte *data, uint16 x);
+void writeUint16LE(byte *data, uint16 x);
+void writeUint32BE(byte *data, uint32 x);
+void writeUint32LE(byte *data, uint32 x);
+
 void readFixedString(std::istream &stream, char *str, int n);
 
-bool dumpToFile(std::istream &input, uint32 offset, uint32 size, const std::string &output);
+/** Calculate the 64-bit FNV-1a hash of a block of data, optionally continuing a previous hash. */
+uint64 hashFNV64(const byte *data, uint32 size, uint64 hash = 0xCBF29CE484222325ULL);
+
+/** Calculate a 64-bit hash of a block of data, working on 8 bytes at a time.
+ *
+ *  Much faster than hashFNV64() on large blocks. Not suited against malicious
+ *  collisions, but the same on every host.
+ */
+uint64 hashData64(const byte *data, uint32 size);
 
 } // End of namespace Common
 
@@ -0,0 +1,961 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file ds2d.cpp
+ *  Daemon keeping parsed and uncompressed archives cached across requests.
+ *
+ *  The daemon listens on a Unix domain socket. Each request is a single line
+ *  of tab-separated fields:
+ *
+ *    l <format> <archive>            List the archive contents
+ *    c <format> <archive> <member>   Look up a single member
+ *
+ *  The format is one of "pgf", "tnd" or "glue", and the archive path has to
+ *  be absolute. Answers start with a line "ERR <message>" or "OK <count>"
+ *  for l, followed by count lines "<name> <offset> <size>", and "OK <offset>
+ *  <size>" for c. A file descriptor holding the archive data, i.e. either
+ *  the archive file itself or the uncompressed image of a compressed glue,
+ *  is attached to every OK answer, and clients read the members from there
+ *  with pread().
+ *
+ *  Only the user running the daemon can connect to the socket.
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+
+#include <list>
+#include <map>
+#include <vector>
+#include <string>
+#include <fstream>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "common/util.h"
+#include "common/version.h"
+#include "common/fileio.h"
+#include "common/outputdir.h"
+#include "common/memreadstream.h"
+#include "common/glue.h"
+#include "common/archive.h"
+
+using Common::FileInfo;
+
+enum Format {
+	kFormatNone    = -1,
+	kFormatPGF         ,
+	kFormatTND         ,
+	kFormatGlue        ,
+	kFormatMAX
+};
+
+enum Command {
+	kCommandNone    = -1,
+	kCommandServe       ,
+	kCommandList        ,
+	kCommandCat         ,
+	kCommandExtract     ,
+	kCommandMAX
+};
+
+const char *kFormatName[kFormatMAX] = { "pgf", "tnd", "glue" };
+
+const char *kCommandChar[kCommandMAX] = { "s", "l", "c", "x" };
+
+/** Default amount of uncompressed glue data to keep around, in MiB. */
+static const uint32 kDefaultCacheSize = 64;
+/** Maximum number of archives to keep open. */
+static const uint32 kMaxArchives = 256;
+/** Maximum length of a request line: a command, a format and two paths. */
+static const uint32 kMaxRequestSize = 2 * PATH_MAX + 64;
+
+/** Can this be sent as a field of a request or an answer? */
+static bool isValidField(const char *field) {
+	return std::strpbrk(field, "\t\n") == 0;
+}
+
+/** A parsed archive, as kept in the cache. */
+struct Archive {
+	std::string path;
+	Format format;
+
+	// Identity of the archive file, to notice when it changes
+	dev_t  device;
+	ino_t  inode;
+	off_t  fileSize;
+	time_t mTime;
+
+	int    fd;     ///< The archive data, either the archive file or an uncompressed image.
+	uint32 memory; ///< Size of the uncompressed image, if any.
+
+	std::list<FileInfo> files;
+
+	Archive() : format(kFormatNone), device(0), inode(0), fileSize(0), mTime(0), fd(-1), memory(0) {
+	}
+
+	~Archive() {
+		Common::closeFile(fd);
+	}
+};
+
+/** A memory-bounded LRU cache of parsed archives. */
+class ArchiveCache {
+public:
+	ArchiveCache(uint64 maxMemory);
+	~ArchiveCache();
+
+	/** Return an archive, parsing it first if it's not in the cache or has changed on disk. */
+	Archive *get(const std::string &path, Format format, std::string &error);
+
+private:
+	typedef std::list<Archive *> ArchiveList;
+	typedef std::map<std::string, ArchiveList::iterator> ArchiveMap;
+
+	uint64 _maxMemory;
+	uint64 _memory;
+
+	ArchiveList _archives; ///< All cached archives, most recently used first.
+	ArchiveMap  _map;
+
+	Archive *load(const std::string &path, Format format, const struct stat &st, std::string &error);
+
+	void drop(const std::string &key);
+	void trim();
+};
+
+/** An answer waiting to be sent to a client. */
+struct Answer {
+	std::string data;
+	size_t sent;
+
+	int fd; ///< Our own duplicate of the descriptor to attach, or -1.
+
+	Answer(const std::string &d, int f) : data(d), sent(0), fd(f) {
+	}
+};
+
+struct Connection {
+	int fd;
+	std::string input;
+
+	/** Answers not completely sent yet. New requests wait until these are out. */
+	std::list<Answer> answers;
+
+	bool eof; ///< Has the client finished sending requests?
+
+	Connection(int f = -1) : fd(f), eof(false) {
+	}
+};
+
+static volatile sig_atomic_t quit = 0;
+
+void printUsage(FILE *stream, const char *name);
+bool parseCommandLine(int argc, char **argv, int &returnValue, Command &command,
+                      std::string &socket, std::vector<std::string> &args);
+
+bool parseFormat(const std::string &name, Format &format);
+
+bool readArchive(std::istream &stream, Format format, std::list<FileInfo> &files);
+
+int serve(const std::string &socketPath, uint32 cacheSize);
+
+int request(const std::string &socketPath, const std::string &req, std::vector<std::string> &lines, int &fd);
+
+int listFiles(const std::string &socketPath, Format format, const std::string &archive);
+int catFile(const std::string &socketPath, Format format, const std::string &archive, const std::string &member);
+int extractFiles(const std::string &socketPath, Format format, const std::string &archive);
+
+int main(int argc, char **argv) {
+	int returnValue;
+	Command command;
+	std::string socketPath;
+	std::vector<std::string> args;
+	if (!parseCommandLine(argc, argv, returnValue, command, socketPath, args))
+		return returnValue;
+
+	if (command == kCommandServe) {
+		uint32 cacheSize = kDefaultCacheSize;
+		if (!args.empty())
+			cacheSize = strtoul(args[0].c_str(), 0, 10);
+
+		return serve(socketPath, cacheSize);
+	}
+
+	Format format;
+	if (!parseFormat(args[0], format)) {
+		std::printf("Unknown archive format \"%s\"\n", args[0].c_str());
+		return 1;
+	}
+
+	// The daemon has its own working directory, so we need an absolute path
+	char archive[PATH_MAX];
+	if (!realpath(args[1].c_str(), archive)) {
+		std::printf("Error opening file \"%s\"\n", args[1].c_str());
+		return 2;
+	}
+
+	if (!isValidField(archive) || ((command == kCommandCat) && !isValidField(args[2].c_str()))) {
+		std::printf("Names with tabs or line breaks can't be sent to the daemon\n");
+		return 1;
+	}
+
+	if      (command == kCommandList)
+		return listFiles(socketPath, format, archive);
+	else if (command == kCommandCat)
+		return catFile(socketPath, format, archive, args[2]);
+	else if (command == kCommandExtract)
+		return extractFiles(socketPath, format, archive);
+
+	return 0;
+}
+
+bool parseCommandLine(int argc, char **argv, int &returnValue, Command &command,
+                      std::string &socket, std::vector<std::string> &args) {
+
+	socket.clear();
+	args.clear();
+
+	// No command, just display the help
+	if (argc == 1) {
+		printUsage(stdout, argv[0]);
+		returnValue = 0;
+
+		return false;
+	}
+
+	// Find out what we should do
+	command = kCommandNone;
+	for (int i = 0; i < kCommandMAX; i++)
+		if (!strcmp(argv[1], kCommandChar[i]))
+			command = (Command) i;
+
+	// Each command has its own number of arguments
+	bool argsValid = false;
+	if      (command == kCommandServe)
+		argsValid = (argc == 3) || (argc == 4);
+	else if ((command == kCommandList) || (command == kCommandExtract))
+		argsValid = argc == 5;
+	else if (command == kCommandCat)
+		argsValid = argc == 6;
+
+	// Unknown command or wrong number of arguments
+	if (!argsValid) {
+		printUsage(stderr, argv[0]);
+		returnValue = 1;
+
+		return false;
+	}
+
+	socket = argv[2];
+	for (int i = 3; i < argc; i++)
+		args.push_back(argv[i]);
+
+	return true;
+}
+
+void printUsage(FILE *stream, const char *name) {
+	std::fprintf(stream, "Dark Seed II archive extraction daemon\n");
+	std::fprintf(stream, "\n");
+	std::fprintf(stream, "%s\n", DS2TOOLS_NAMEVERSION);
+	std::fprintf(stream, "Copyright (c) %s, %s\n", DS2TOOLS_COPYRIGHTYEAR, DS2TOOLS_COPYRIGHTAUTHOR);
+	std::fprintf(stream, "%s\n", DS2TOOLS_URL);
+	std::fprintf(stream, "\n");
+	std::fprintf(stream, "Usage: %s s <socket> [<cache size in MiB>]\n", name);
+	std::fprintf(stream, "       %s l|x <socket> <format> <file>\n", name);
+	std::fprintf(stream, "       %s c <socket> <format> <file> <member>\n\n", name);
+	std::fprintf(stream, "Commands:\n");
+	std::fprintf(stream, "  s          Serve requests on the socket (default cache size: %u MiB)\n", kDefaultCacheSize);
+	std::fprintf(stream, "  l          List archive contents\n");
+	std::fprintf(stream, "  c          Write a member to stdout\n");
+	std::fprintf(stream, "  x          Extract files to current directory\n");
+	std::fprintf(stream, "\n");
+	std::fprintf(stream, "Formats: pgf, tnd, glue\n");
+}
+
+bool parseFormat(const std::string &name, Format &format) {
+	for (int i = 0; i < kFormatMAX; i++) {
+		if (name == kFormatName[i]) {
+			format = (Format) i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool readArchive(std::istream &stream, Format format, std::list<FileInfo> &files) {
+	if      (format == kFormatPGF)
+		return Common::readArchive<Common::PGFFormat>(stream, files);
+	else if (format == kFormatTND)
+		return Common::readArchive<Common::TNDFormat>(stream, files);
+	else if (format == kFormatGlue)
+		return Common::readArchive<Common::GlueFormat>(stream, files);
+
+	return false;
+}
+
+ArchiveCache::ArchiveCache(uint64 maxMemory) : _maxMemory(maxMemory), _memory(0) {
+}
+
+ArchiveCache::~ArchiveCache() {
+	for (ArchiveList::iterator a = _archives.begin(); a != _archives.end(); ++a)
+		delete *a;
+}
+
+Archive *ArchiveCache::get(const std::string &path, Format format, std::string &error) {
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) {
+		error = "Error opening file";
+		return 0;
+	}
+
+	const std::string key = std::string(kFormatName[format]) + ":" + path;
+
+	ArchiveMap::iterator cached = _map.find(key);
+	if (cached != _map.end()) {
+		Archive *archive = *cached->second;
+
+		if ((archive->device == st.st_dev) && (archive->inode == st.st_ino) &&
+		    (archive->fileSize == st.st_size) && (archive->mTime == st.st_mtime)) {
+
+			// Still up-to-date, mark it as most recently used
+			_archives.splice(_archives.begin(), _archives, cached->second);
+			return archive;
+		}
+
+		drop(key);
+	}
+
+	Archive *archive = load(path, format, st, error);
+	if (!archive)
+		return 0;
+
+	_archives.push_front(archive);
+	_map[key] = _archives.begin();
+
+	_memory += archive->memory;
+	trim();
+
+	return archive;
+}
+
+Archive *ArchiveCache::load(const std::string &path, Format format, const struct stat &st, std::string &error) {
+	std::ifstream file(path.c_str());
+	if (!file.is_open()) {
+		error = "Error opening file";
+		return 0;
+	}
+
+	Archive *archive = new Archive;
+
+	archive->path     = path;
+	archive->format   = format;
+	archive->device   = st.st_dev;
+	archive->inode    = st.st_ino;
+	archive->fileSize = st.st_size;
+	archive->mTime    = st.st_mtime;
+
+	if ((format == kFormatGlue) && Common::isCompressedGlue(file)) {
+		// Uncompress the glue straight into an anonymous file we can hand out
+
+		uint32 size = Common::getUncompressedGlueSize(file);
+
+		archive->fd = Common::createMemoryFile("ds2d");
+		if ((size == 0) || (archive->fd < 0) || (ftruncate(archive->fd, size) != 0)) {
+			error = "Failed to uncompress the glue";
+			delete archive;
+			return 0;
+		}
+
+		void *image = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, archive->fd, 0);
+		if (image == MAP_FAILED) {
+			error = "Failed to uncompress the glue";
+			delete archive;
+			return 0;
+		}
+
+		if (Common::uncompressGlue(file, (byte *) image, size)) {
+			Common::MemoryReadStream uncompressed((byte *) image, size);
+
+			if (!readArchive(uncompressed, format, archive->files))
+				error = "Not a valid archive";
+
+			archive->memory = size;
+		} else
+			error = "Failed to uncompress the glue";
+
+		munmap(image, size);
+
+	} else {
+		if (!readArchive(file, format, archive->files))
+			error = "Not a valid archive";
+
+		archive->fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	}
+
+	// The names are sent as tab-separated fields of a line
+	for (std::list<FileInfo>::const_iterator f = archive->files.begin(); error.empty() && (f != archive->files.end()); ++f)
+		if (!isValidField(f->name))
+			error = "Invalid file name in the archive";
+
+	if ((archive->fd < 0) || !error.empty()) {
+		if (error.empty())
+			error = "Error opening file";
+
+		delete archive;
+		return 0;
+	}
+
+	return archive;
+}
+
+void ArchiveCache::drop(const std::string &key) {
+	ArchiveMap::iterator cached = _map.find(key);
+	if (cached == _map.end())
+		return;
+
+	Archive *archive = *cached->second;
+
+	_memory -= archive->memory;
+
+	_archives.erase(cached->second);
+	_map.erase(cached);
+
+	delete archive;
+}
+
+void ArchiveCache::trim() {
+	// Evict the least recently used archives, but always keep the newest one
+	while ((_archives.size() > 1) &&
+	       ((_memory > _maxMemory) || (_archives.size() > kMaxArchives))) {
+
+		Archive *archive = _archives.back();
+
+		drop(std::string(kFormatName[archive->format]) + ":" + archive->path);
+	}
+}
+
+static void splitFields(const std::string &line, std::vector<std::string> &fields) {
+	fields.clear();
+
+	std::string::size_type start = 0;
+	while (true) {
+		std::string::size_type tab = line.find('\t', start);
+
+		fields.push_back(line.substr(start, tab - start));
+		if (tab == std::string::npos)
+			break;
+
+		start = tab + 1;
+	}
+}
+
+/** Queue an answer, attaching a duplicate of a file descriptor if fd >= 0.
+ *
+ *  The descriptor is duplicated, because the archive it belongs to might
+ *  be dropped from the cache before the answer is sent.
+ */
+static bool queueAnswer(Connection &connection, const std::string &answer, int fd) {
+	if (fd >= 0) {
+		fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+		if (fd < 0)
+			return false;
+	}
+
+	connection.answers.push_back(Answer(answer, fd));
+	return true;
+}
+
+/** Send as much of the queued answers as the client takes without blocking. Returns false on errors. */
+static bool sendAnswers(Connection &connection) {
+	char control[CMSG_SPACE(sizeof(int))];
+
+	while (!connection.answers.empty()) {
+		Answer &answer = connection.answers.front();
+
+		struct iovec iov;
+		iov.iov_base = (void *) (answer.data.c_str() + answer.sent);
+		iov.iov_len  = answer.data.size() - answer.sent;
+
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+
+		msg.msg_iov    = &iov;
+		msg.msg_iovlen = 1;
+
+		// The descriptor travels with the first bytes of the answer
+		if (answer.fd >= 0) {
+			memset(control, 0, sizeof(control));
+
+			msg.msg_control    = control;
+			msg.msg_controllen = sizeof(control);
+
+			struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type  = SCM_RIGHTS;
+			cmsg->cmsg_len   = CMSG_LEN(sizeof(int));
+
+			memcpy(CMSG_DATA(cmsg), &answer.fd, sizeof(int));
+		}
+
+		ssize_t n = sendmsg(connection.fd, &msg, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			// The client isn't reading right now, try again once poll() says so
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				return true;
+
+			return false;
+		}
+
+		Common::closeFile(answer.fd);
+		answer.fd = -1;
+
+		answer.sent += n;
+		if (answer.sent == answer.data.size())
+			connection.answers.pop_front();
+	}
+
+	return true;
+}
+
+static void dropAnswers(Connection &connection) {
+	for (std::list<Answer>::iterator a = connection.answers.begin(); a != connection.answers.end(); ++a)
+		Common::closeFile(a->fd);
+
+	connection.answers.clear();
+}
+
+static bool handleRequest(Connection &connection, const std::string &line, ArchiveCache &cache) {
+	std::vector<std::string> fields;
+	splitFields(line, fields);
+
+	Format format;
+	if ((fields.size() < 3) || !parseFormat(fields[1], format) || fields[2].empty() || (fields[2][0] != '/'))
+		return queueAnswer(connection, "ERR\tInvalid request\n", -1);
+
+	std::string error;
+	Archive *archive = cache.get(fields[2], format, error);
+	if (!archive)
+		return queueAnswer(connection, "ERR\t" + error + "\n", -1);
+
+	char buffer[64];
+
+	if ((fields[0] == kCommandChar[kCommandList]) && (fields.size() == 3)) {
+		std::snprintf(buffer, sizeof(buffer), "OK\t%u\n", (uint) archive->files.size());
+
+		std::string answer = buffer;
+		for (std::list<FileInfo>::const_iterator f = archive->files.begin(); f != archive->files.end(); ++f) {
+			std::snprintf(buffer, sizeof(buffer), "\t%u\t%u\n", f->offset, f->size);
+
+			answer += f->name;
+			answer += buffer;
+		}
+
+		return queueAnswer(connection, answer, archive->fd);
+	}
+
+	if ((fields[0] == kCommandChar[kCommandCat]) && (fields.size() == 4)) {
+		for (std::list<FileInfo>::const_iterator f = archive->files.begin(); f != archive->files.end(); ++f) {
+			if (fields[3] == f->name) {
+				std::snprintf(buffer, sizeof(buffer), "OK\t%u\t%u\n", f->offset, f->size);
+
+				return queueAnswer(connection, buffer, archive->fd);
+			}
+		}
+
+		return queueAnswer(connection, "ERR\tNo such file in the archive\n", -1);
+	}
+
+	return queueAnswer(connection, "ERR\tInvalid request\n", -1);
+}
+
+/** Read from a connection, answer all complete requests and send what the client takes.
+ *
+ *  Never blocks: a client not reading its answers only holds back its own
+ *  further requests. Returns false when the connection is done.
+ */
+static bool handleConnection(Connection &connection, short events, ArchiveCache &cache) {
+	if (!connection.eof && connection.answers.empty() && (events & (POLLIN | POLLHUP | POLLERR))) {
+		char buffer[4096];
+
+		ssize_t n = recv(connection.fd, buffer, sizeof(buffer), 0);
+		if (n < 0) {
+			if ((errno != EINTR) && (errno != EAGAIN) && (errno != EWOULDBLOCK))
+				return false;
+		} else if (n == 0)
+			connection.eof = true;
+		else
+			connection.input.append(buffer, n);
+	}
+
+	if (!sendAnswers(connection))
+		return false;
+
+	std::string::size_type newLine;
+	while (connection.answers.empty() && ((newLine = connection.input.find('\n')) != std::string::npos)) {
+		std::string line = connection.input.substr(0, newLine);
+		connection.input.erase(0, newLine + 1);
+
+		if (!handleRequest(connection, line, cache) || !sendAnswers(connection))
+			return false;
+	}
+
+	// Don't buffer a request that never ends
+	newLine = connection.input.find('\n');
+	if (((newLine == std::string::npos) ? connection.input.size() : newLine) > kMaxRequestSize)
+		return false;
+
+	// Done once the client stopped sending and got all its answers
+	return !connection.eof || !connection.answers.empty();
+}
+
+static void signalHandler(int) {
+	quit = 1;
+}
+
+/** Remove a stale socket, but nothing else that might have taken its name. */
+static bool removeSocket(const std::string &socketPath) {
+	struct stat st;
+	if (lstat(socketPath.c_str(), &st) != 0)
+		return errno == ENOENT;
+
+	if (!S_ISSOCK(st.st_mode))
+		return false;
+
+	return unlink(socketPath.c_str()) == 0;
+}
+
+static bool fillAddress(struct sockaddr_un &address, const std::string &socketPath) {
+	memset(&address, 0, sizeof(address));
+
+	address.sun_family = AF_UNIX;
+	if (socketPath.size() >= sizeof(address.sun_path)) {
+		std::printf("Socket path \"%s\" too long\n", socketPath.c_str());
+		return false;
+	}
+
+	strcpy(address.sun_path, socketPath.c_str());
+	return true;
+}
+
+int serve(const std::string &socketPath, uint32 cacheSize) {
+	struct sockaddr_un address;
+	if (!fillAddress(address, socketPath))
+		return 1;
+
+	int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (listener < 0) {
+		std::printf("Error creating socket \"%s\"\n", socketPath.c_str());
+		return 2;
+	}
+
+	// Remove stale sockets, but don't take over from a running daemon
+	if (connect(listener, (struct sockaddr *) &address, sizeof(address)) == 0) {
+		std::printf("Another daemon is already serving \"%s\"\n", socketPath.c_str());
+		close(listener);
+		return 2;
+	}
+
+	if ((errno == ECONNREFUSED) && !removeSocket(socketPath)) {
+		std::printf("\"%s\" exists and is not a socket\n", socketPath.c_str());
+		close(listener);
+		return 2;
+	}
+
+	/* Whoever can connect can read any file the daemon can, so only allow the
+	 * owner. The umask keeps others out between bind() and chmod() already. */
+	const mode_t mask = umask(0077);
+	const bool bound  = bind(listener, (struct sockaddr *) &address, sizeof(address)) == 0;
+	umask(mask);
+
+	if (!bound || (chmod(socketPath.c_str(), 0600) != 0) || (listen(listener, 64) != 0)) {
+		std::printf("Error creating socket \"%s\"\n", socketPath.c_str());
+		close(listener);
+		return 2;
+	}
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = signalHandler;
+
+	sigaction(SIGINT , &action, 0);
+	sigaction(SIGTERM, &action, 0);
+	signal(SIGPIPE, SIG_IGN);
+
+	ArchiveCache cache((uint64) cacheSize * 1024 * 1024);
+
+	std::list<Connection> connections;
+
+	int result = 0;
+	while (!quit) {
+		std::vector<struct pollfd> fds(1 + connections.size());
+
+		fds[0].fd     = listener;
+		fds[0].events = POLLIN;
+
+		// Wait for new requests, or for room to send pending answers
+		size_t i = 1;
+		for (std::list<Connection>::const_iterator c = connections.begin(); c != connections.end(); ++c, ++i) {
+			fds[i].fd     = c->fd;
+			fds[i].events = c->answers.empty() ? POLLIN : POLLOUT;
+		}
+
+		if (poll(&fds[0], fds.size(), -1) < 0)
+			continue;
+
+		i = 1;
+		for (std::list<Connection>::iterator c = connections.begin(); c != connections.end(); ++i) {
+			if (fds[i].revents && !handleConnection(*c, fds[i].revents, cache)) {
+				dropAnswers(*c);
+				close(c->fd);
+				c = connections.erase(c);
+			} else
+				++c;
+		}
+
+		// The listening socket itself broke, it would only keep poll() from ever waiting again
+		if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+			std::printf("Error on socket \"%s\"\n", socketPath.c_str());
+			result = 2;
+			break;
+		}
+
+		if (fds[0].revents & POLLIN) {
+			int fd = accept(listener, 0, 0);
+			if (fd >= 0) {
+				// A client that doesn't read its answers must not stall everybody else
+				fcntl(fd, F_SETFD, FD_CLOEXEC);
+				fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+				connections.push_back(Connection(fd));
+			}
+		}
+	}
+
+	for (std::list<Connection>::iterator c = connections.begin(); c != connections.end(); ++c) {
+		dropAnswers(*c);
+		close(c->fd);
+	}
+
+	close(listener);
+	removeSocket(socketPath);
+
+	return result;
+}
+
+int request(const std::string &socketPath, const std::string &req, std::vector<std::string> &lines, int &fd) {
+	lines.clear();
+	fd = -1;
+
+	struct sockaddr_un address;
+	if (!fillAddress(address, socketPath))
+		return 1;
+
+	int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if ((sock < 0) || (connect(sock, (struct sockaddr *) &address, sizeof(address)) != 0)) {
+		std::printf("Error connecting to \"%s\"\n", socketPath.c_str());
+		if (sock >= 0)
+			close(sock);
+		return 2;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+
+	// One request per connection: the daemon closes after answering
+	if (!Common::writeData(sock, (const byte *) req.c_str(), req.size()) || (shutdown(sock, SHUT_WR) != 0)) {
+		std::printf("Error sending the request\n");
+		close(sock);
+		return 2;
+	}
+
+	std::string answer;
+	while (true) {
+		char buffer[4096];
+		char control[CMSG_SPACE(sizeof(int))];
+
+		struct iovec iov;
+		iov.iov_base = buffer;
+		iov.iov_len  = sizeof(buffer);
+
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+
+		msg.msg_iov        = &iov;
+		msg.msg_iovlen     = 1;
+		msg.msg_control    = control;
+		msg.msg_controllen = sizeof(control);
+
+		ssize_t n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+		if ((n < 0) && (errno == EINTR))
+			continue;
+		if (n <= 0)
+			break;
+
+		for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+			if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_RIGHTS) && (fd < 0))
+				memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+
+		answer.append(buffer, n);
+	}
+
+	close(sock);
+
+	std::string::size_type start = 0, newLine;
+	while ((newLine = answer.find('\n', start)) != std::string::npos) {
+		lines.push_back(answer.substr(start, newLine - start));
+		start = newLine + 1;
+	}
+
+	std::vector<std::string> fields;
+	if (!lines.empty())
+		splitFields(lines[0], fields);
+
+	if (fields.empty() || (fields[0] != "OK") || (fd < 0)) {
+		if ((fields.size() >= 2) && (fields[0] == "ERR"))
+			std::printf("%s\n", fields[1].c_str());
+		else
+			std::printf("Invalid answer from the daemon\n");
+
+		Common::closeFile(fd);
+		fd = -1;
+
+		return 3;
+	}
+
+	return 0;
+}
+
+static int requestList(const std::string &socketPath, Format format, const std::string &archive,
+                       std::list<FileInfo> &files, int &fd) {
+
+	std::vector<std::string> lines;
+	int result = request(socketPath, std::string("l\t") + kFormatName[format] + "\t" + archive + "\n", lines, fd);
+	if (result != 0)
+		return result;
+
+	std::vector<std::string> fields;
+	for (size_t i = 1; i < lines.size(); i++) {
+		splitFields(lines[i], fields);
+		if (fields.size() != 3)
+			continue;
+
+		files.push_back(FileInfo(fields[0].c_str(), strtoul(fields[1].c_str(), 0, 10), strtoul(fields[2].c_str(), 0, 10)));
+	}
+
+	return 0;
+}
+
+int listFiles(const std::string &socketPath, Format format, const std::string &archive) {
+	int fd;
+	std::list<FileInfo> files;
+
+	int result = requestList(socketPath, format, archive, files, fd);
+	if (result != 0)
+		return result;
+
+	Common::closeFile(fd);
+
+	std::printf("Number of files: %u\n\n", (uint) files.size());
+
+	std::printf(" Filename    | Size\n");
+	std::printf("=============|===========\n");
+
+	for (std::list<FileInfo>::const_iterator f = files.begin(); f != files.end(); ++f)
+		std::printf("%12s | %10d\n", f->name, f->size);
+
+	return 0;
+}
+
+int catFile(const std::string &socketPath, Format format, const std::string &archive, const std::string &member) {
+	int fd;
+	std::vector<std::string> lines, fields;
+
+	int result = request(socketPath, std::string("c\t") + kFormatName[format] + "\t" + archive + "\t" + member + "\n", lines, fd);
+	if (result != 0)
+		return result;
+
+	splitFields(lines[0], fields);
+
+	bool success = (fields.size() == 3) &&
+	               Common::copyDataAt(1, fd, strtoul(fields[1].c_str(), 0, 10), strtoul(fields[2].c_str(), 0, 10));
+
+	Common::closeFile(fd);
+
+	return success ? 0 : 3;
+}
+
+int extractFiles(const std::string &socketPath, Format format, const std::string &archive) {
+	int fd;
+	std::list<FileInfo> files;
+
+	int result = requestList(socketPath, format, archive, files, fd);
+	if (result != 0)
+		return result;
+
+	Common::OutputDirectory output;
+	if (!output.open(".")) {
+		std::printf("Error opening the current directory\n");
+		Common::closeFile(fd);
+		return 2;
+	}
+
+	const uint fileCount = files.size();
+
+	std::printf("Number of files: %u\n\n", fileCount);
+
+	uint i = 1;
+	for (std::list<FileInfo>::const_iterator f = files.begin(); f != files.end(); ++f, ++i) {
+		std::printf("Extracting %u/%u: \"%s\"... ", i, fileCount, f->name);
+		std::fflush(stdout);
+
+		if (output.copyFile(f->name, fd, f->offset, f->size))
+			std::printf("done\n");
+		else
+			std::printf("FAILED\n");
+	}
+
+	Common::closeFile(fd);
+
+	return 0;
+}
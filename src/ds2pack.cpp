@@ -0,0 +1,648 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file ds2pack.cpp
+ *  Tool to convert a whole set of archives into a single pack file.
+ *
+ *  A pack file holds the members of many PGF, TND and glue archives, each
+ *  named "<archive path>/<member name>". It's meant to be mapped into memory
+ *  by a consumer, which then finds any member with a single hash probe. See
+ *  common/packfile.h for the format.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+#include <list>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <condition_variable>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "common/util.h"
+#include "common/version.h"
+#include "common/fileio.h"
+#include "common/input.h"
+#include "common/memreadstream.h"
+#include "common/glue.h"
+#include "common/archive.h"
+#include "common/packfile.h"
+#include "common/memorybudget.h"
+#include "common/outputdir.h"
+
+using Common::FileInfo;
+
+enum Format {
+	kFormatNone    = -1,
+	kFormatPGF         ,
+	kFormatTND         ,
+	kFormatGlue        ,
+	kFormatMAX
+};
+
+enum Command {
+	kCommandNone    = -1,
+	kCommandCreate      ,
+	kCommandList        ,
+	kCommandExtract     ,
+	kCommandMAX
+};
+
+const char *kFormatExtension[kFormatMAX] = { ".pgf", ".tnd", ".glu" };
+
+const char *kCommandChar[kCommandMAX] = { "c", "l", "x" };
+
+/** Everything found on the command line, besides the command and its arguments. */
+struct PackOptions {
+	bool compress; ///< Compress members.
+
+	uint32 jobs;      ///< Number of threads opening and uncompressing archives ahead.
+	uint32 maxMemory; ///< Limit on the memory of archives uncompressed ahead, in MiB, or 0.
+
+	PackOptions() : compress(false), jobs(1), maxMemory(0) {
+	}
+};
+
+/** An archive to put into the pack file. */
+struct ArchiveFile {
+	std::string path; ///< Where to find the archive.
+	std::string name; ///< The name of the archive within the pack file.
+	Format format;
+};
+
+void printUsage(FILE *stream, const char *name);
+bool parseCommandLine(int argc, char **argv, int &returnValue, Command &command, PackOptions &options,
+                      std::string &pack, std::vector<std::string> &args);
+
+Format findFormat(const std::string &path);
+
+bool readArchive(std::istream &stream, Format format, std::list<FileInfo> &files);
+
+bool collectArchives(const std::vector<std::string> &paths, std::list<ArchiveFile> &archives);
+
+int createPack(const std::string &pack, const std::vector<std::string> &paths, const PackOptions &options);
+int listPack(const std::string &pack);
+int extractPack(const std::string &pack, const std::vector<std::string> &members);
+
+int main(int argc, char **argv) {
+	int returnValue;
+	Command command;
+	PackOptions options;
+	std::string pack;
+	std::vector<std::string> args;
+	if (!parseCommandLine(argc, argv, returnValue, command, options, pack, args))
+		return returnValue;
+
+	if      (command == kCommandCreate)
+		return createPack(pack, args, options);
+	else if (command == kCommandList)
+		return listPack(pack);
+	else if (command == kCommandExtract)
+		return extractPack(pack, args);
+
+	return 0;
+}
+
+bool parseCommandLine(int argc, char **argv, int &returnValue, Command &command, PackOptions &options,
+                      std::string &pack, std::vector<std::string> &args) {
+
+	options = PackOptions();
+	pack.clear();
+	args.clear();
+
+	// No command, just display the help
+	if (argc == 1) {
+		printUsage(stdout, argv[0]);
+		returnValue = 0;
+
+		return false;
+	}
+
+	// Options come before the command
+	int arg = 1;
+	for (; (arg < argc) && !strncmp(argv[arg], "--", 2); arg++) {
+		if (!strcmp(argv[arg], "--compress")) {
+			options.compress = true;
+		} else if (!strncmp(argv[arg], "--jobs=", 7)) {
+			options.jobs = MAX<uint32>(strtoul(argv[arg] + 7, 0, 10), 1);
+		} else if (!strncmp(argv[arg], "--max-memory=", 13)) {
+			options.maxMemory = strtoul(argv[arg] + 13, 0, 10);
+		} else {
+			printUsage(stderr, argv[0]);
+			returnValue = 1;
+
+			return false;
+		}
+	}
+
+	// Find out what we should do
+	command = kCommandNone;
+	if (arg < argc)
+		for (int i = 0; i < kCommandMAX; i++)
+			if (!strcmp(argv[arg], kCommandChar[i]))
+				command = (Command) i;
+
+	// Each command has its own number of arguments
+	bool argsValid = false;
+	if      (command == kCommandCreate)
+		argsValid = (argc - arg) >= 3;
+	else if (command == kCommandList)
+		argsValid = (argc - arg) == 2;
+	else if (command == kCommandExtract)
+		argsValid = (argc - arg) >= 2;
+
+	// Unknown command or wrong number of arguments
+	if (!argsValid) {
+		printUsage(stderr, argv[0]);
+		returnValue = 1;
+
+		return false;
+	}
+
+	pack = argv[arg + 1];
+	for (int i = arg + 2; i < argc; i++)
+		args.push_back(argv[i]);
+
+	return true;
+}
+
+void printUsage(FILE *stream, const char *name) {
+	std::fprintf(stream, "Dark Seed II archive packer\n");
+	std::fprintf(stream, "\n");
+	std::fprintf(stream, "%s\n", DS2TOOLS_NAMEVERSION);
+	std::fprintf(stream, "Copyright (c) %s, %s\n", DS2TOOLS_COPYRIGHTYEAR, DS2TOOLS_COPYRIGHTAUTHOR);
+	std::fprintf(stream, "%s\n", DS2TOOLS_URL);
+	std::fprintf(stream, "\n");
+	std::fprintf(stream, "Usage: %s [<options>] c <pack> <archive|directory> [...]\n", name);
+	std::fprintf(stream, "       %s l <pack>\n", name);
+	std::fprintf(stream, "       %s x <pack> [<member> ...]\n\n", name);
+	std::fprintf(stream, "Options:\n");
+	std::fprintf(stream, "  --compress          Compress every member that gets smaller by it\n");
+	std::fprintf(stream, "  --jobs=<n>          Open and uncompress up to n archives ahead at once\n");
+	std::fprintf(stream, "  --max-memory=<MiB>  Limit the memory of the glues uncompressed ahead\n");
+	std::fprintf(stream, "\n");
+	std::fprintf(stream, "Commands:\n");
+	std::fprintf(stream, "  c          Create a pack file out of archives, and all archives within directories\n");
+	std::fprintf(stream, "  l          List pack file contents\n");
+	std::fprintf(stream, "  x          Extract all members, or only the given ones, to current directory\n");
+	std::fprintf(stream, "\n");
+	std::fprintf(stream, "Archives are recognized by their extension: .pgf, .tnd and .glu\n");
+}
+
+Format findFormat(const std::string &path) {
+	const std::string::size_type dot = path.find_last_of("./");
+	if ((dot == std::string::npos) || (path[dot] != '.'))
+		return kFormatNone;
+
+	for (int i = 0; i < kFormatMAX; i++)
+		if (!strcasecmp(path.c_str() + dot, kFormatExtension[i]))
+			return (Format) i;
+
+	return kFormatNone;
+}
+
+bool readArchive(std::istream &stream, Format format, std::list<FileInfo> &files) {
+	if      (format == kFormatPGF)
+		return Common::readArchive<Common::PGFFormat>(stream, files);
+	else if (format == kFormatTND)
+		return Common::readArchive<Common::TNDFormat>(stream, files);
+	else if (format == kFormatGlue)
+		return Common::readArchive<Common::GlueFormat>(stream, files);
+
+	return false;
+}
+
+/** Recursively find all archives within a directory, in a stable order. */
+static bool collectDirectory(const std::string &path, const std::string &name, std::list<ArchiveFile> &archives) {
+	DIR *dir = opendir(path.c_str());
+	if (!dir) {
+		std::printf("Error opening directory \"%s\"\n", path.c_str());
+		return false;
+	}
+
+	std::vector<std::string> entries;
+
+	struct dirent *entry;
+	while ((entry = readdir(dir)))
+		if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, ".."))
+			entries.push_back(entry->d_name);
+
+	closedir(dir);
+
+	std::sort(entries.begin(), entries.end());
+
+	for (std::vector<std::string>::const_iterator e = entries.begin(); e != entries.end(); ++e) {
+		const std::string entryPath = path + "/" + *e;
+		const std::string entryName = name.empty() ? *e : (name + "/" + *e);
+
+		struct stat st;
+		if (stat(entryPath.c_str(), &st) != 0)
+			continue;
+
+		if (S_ISDIR(st.st_mode)) {
+			if (!collectDirectory(entryPath, entryName, archives))
+				return false;
+
+			continue;
+		}
+
+		ArchiveFile archive;
+
+		archive.path   = entryPath;
+		archive.name   = entryName;
+		archive.format = findFormat(*e);
+
+		if (S_ISREG(st.st_mode) && (archive.format != kFormatNone))
+			archives.push_back(archive);
+	}
+
+	return true;
+}
+
+bool collectArchives(const std::vector<std::string> &paths, std::list<ArchiveFile> &archives) {
+	for (std::vector<std::string>::const_iterator p = paths.begin(); p != paths.end(); ++p) {
+		std::string path = *p;
+		while ((path.size() > 1) && (path[path.size() - 1] == '/'))
+			path.erase(path.size() - 1);
+
+		struct stat st;
+		if ((stat(path.c_str(), &st) == 0) && S_ISDIR(st.st_mode)) {
+			if (!collectDirectory(path, "", archives))
+				return false;
+
+			continue;
+		}
+
+		// Everything else is an archive file, possibly within a CD image
+		ArchiveFile archive;
+
+		const std::string::size_type slash = path.find_last_of('/');
+
+		archive.path   = path;
+		archive.name   = (slash == std::string::npos) ? path : path.substr(slash + 1);
+		archive.format = findFormat(path);
+
+		if (archive.format == kFormatNone) {
+			std::printf("Unknown archive type of file \"%s\"\n", path.c_str());
+			return false;
+		}
+
+		archives.push_back(archive);
+	}
+
+	return true;
+}
+
+/** An archive, opened and uncompressed ahead of packing it. */
+struct PreparedArchive {
+	std::istream *file;
+	std::istream *stream; ///< The file, or its uncompressed image.
+
+	uint64 reserved; ///< Memory reserved for the uncompressed image.
+
+	std::string error; ///< Why the archive couldn't be opened, if it couldn't.
+
+	bool ready;
+
+	PreparedArchive() : file(0), stream(0), reserved(0), ready(false) {
+	}
+
+	void close() {
+		if (stream != file)
+			delete stream;
+		delete file;
+
+		stream = file = 0;
+	}
+};
+
+/** Open an archive and uncompress it if necessary, within the memory budget.
+ *
+ *  @param  index  The number of the archive, in the order they are packed.
+ *  @param  pooled Uncompress into the calling thread's buffer pool. Buffers
+ *                 of other threads would end up in the packing thread's
+ *                 pool, outside of the budget.
+ */
+static void prepareArchive(const ArchiveFile &archive, PreparedArchive &prepared, Common::MemoryBudget &budget,
+                           uint32 index, bool pooled) {
+
+	uint64 imageSize = 0;
+
+	prepared.file = Common::openInputFile(archive.path);
+	if (!prepared.file)
+		prepared.error = "Error opening file \"" + archive.path + "\"";
+	else if ((archive.format == kFormatGlue) && Common::isCompressedGlue(*prepared.file))
+		imageSize = Common::getUncompressedGlueSize(*prepared.file);
+
+	prepared.reserved = budget.reserve(index, imageSize);
+	prepared.stream   = prepared.file;
+
+	if (imageSize == 0)
+		return;
+
+	if (pooled) {
+		prepared.stream = Common::uncompressGlue(*prepared.file);
+	} else {
+		byte *image = new byte[imageSize];
+
+		if (Common::uncompressGlue(*prepared.file, image, imageSize))
+			prepared.stream = new Common::MemoryReadStream(image, imageSize, true);
+		else {
+			prepared.stream = 0;
+			delete[] image;
+		}
+	}
+
+	if (!prepared.stream) {
+		prepared.stream = prepared.file;
+		prepared.error  = "Failed to uncompress the glue \"" + archive.path + "\"";
+	}
+}
+
+/** Put all members of an archive into the pack file. */
+static bool packArchive(const ArchiveFile &archive, std::istream &stream, Common::PackWriter &pack, bool compress) {
+	std::list<FileInfo> files;
+	bool success = readArchive(stream, archive.format, files);
+	if (!success) {
+		std::printf("Not a valid archive \"%s\"\n", archive.path.c_str());
+		return false;
+	}
+
+	std::printf("Packing \"%s\" (%u files)... ", archive.name.c_str(), (uint) files.size());
+	std::fflush(stdout);
+
+	std::vector<byte> data;
+	for (std::list<FileInfo>::const_iterator f = files.begin(); success && (f != files.end()); ++f) {
+		const std::string name = archive.name + "/" + f->name;
+
+		if (pack.hasMember(name)) {
+			std::printf("FAILED\nDuplicate member \"%s\"\n", name.c_str());
+			success = false;
+			break;
+		}
+
+		data.resize(MAX<uint32>(f->size, 1));
+
+		stream.clear();
+		stream.seekg(f->offset, std::ios_base::beg);
+		stream.read((char *) &data[0], f->size);
+
+		if ((uint32) stream.gcount() != f->size) {
+			std::printf("FAILED\nError reading \"%s\"\n", name.c_str());
+			success = false;
+			break;
+		}
+
+		if (!pack.addMember(name, &data[0], f->size, compress)) {
+			std::printf("FAILED\nError writing \"%s\"\n", name.c_str());
+			success = false;
+			break;
+		}
+	}
+
+	if (success)
+		std::printf("done\n");
+
+	return success;
+}
+
+/** Archives being prepared by worker threads, to be packed in order. */
+struct PrepareQueue {
+	const std::vector<ArchiveFile> *archives;
+	std::vector<PreparedArchive> prepared;
+
+	Common::MemoryBudget *budget;
+
+	std::atomic<uint32> next;    ///< The next archive to prepare.
+	std::atomic<bool>   aborted; ///< Packing failed, only pass the remaining archives through.
+
+	uint32 taken; ///< The number of archives taken for packing.
+	uint32 ahead; ///< How many archives may be prepared ahead of packing.
+
+	std::mutex mutex;
+	std::condition_variable readied;
+	std::condition_variable packed;
+
+	PrepareQueue(const std::vector<ArchiveFile> &a, Common::MemoryBudget &b, uint32 jobs) :
+		archives(&a), prepared(a.size()), budget(&b), next(0), aborted(false), taken(0), ahead(jobs) {
+	}
+};
+
+static void prepareWorker(PrepareQueue *queue) {
+	uint32 i;
+	while ((i = queue->next.fetch_add(1)) < queue->archives->size()) {
+		PreparedArchive prepared;
+
+		// Even without a memory limit, don't run off too far ahead
+		{
+			std::unique_lock<std::mutex> lock(queue->mutex);
+			while (i >= (queue->taken + queue->ahead))
+				queue->packed.wait(lock);
+		}
+
+		if (queue->aborted.load())
+			queue->budget->reserve(i, 0);
+		else
+			prepareArchive((*queue->archives)[i], prepared, *queue->budget, i, false);
+
+		prepared.ready = true;
+
+		std::lock_guard<std::mutex> lock(queue->mutex);
+
+		queue->prepared[i] = prepared;
+		queue->readied.notify_all();
+	}
+}
+
+int createPack(const std::string &packFile, const std::vector<std::string> &paths, const PackOptions &options) {
+	std::list<ArchiveFile> archiveList;
+	if (!collectArchives(paths, archiveList))
+		return 2;
+
+	const std::vector<ArchiveFile> archives(archiveList.begin(), archiveList.end());
+
+	Common::PackWriter pack;
+	if (!pack.create(packFile)) {
+		std::printf("Error creating file \"%s\"\n", packFile.c_str());
+		return 2;
+	}
+
+	std::printf("Number of archives: %u\n\n", (uint) archives.size());
+
+	Common::MemoryBudget budget((uint64) options.maxMemory * 1024 * 1024);
+	PrepareQueue queue(archives, budget, options.jobs);
+
+	// With more than one job, worker threads prepare the archives ahead
+	std::vector<std::thread> workers;
+	if (options.jobs > 1)
+		for (uint32 i = 0; i < options.jobs; i++)
+			workers.push_back(std::thread(prepareWorker, &queue));
+
+	int returnValue = 0;
+	for (uint32 i = 0; i < archives.size(); i++) {
+		PreparedArchive prepared;
+
+		if (workers.empty()) {
+			prepareArchive(archives[i], prepared, budget, i, true);
+		} else {
+			std::unique_lock<std::mutex> lock(queue.mutex);
+			while (!queue.prepared[i].ready)
+				queue.readied.wait(lock);
+
+			prepared = queue.prepared[i];
+
+			queue.taken = i + 1;
+			queue.packed.notify_all();
+		}
+
+		// After a failure, keep taking the prepared archives, to give back their memory
+		if (returnValue == 0) {
+			if (!prepared.error.empty()) {
+				std::printf("%s\n", prepared.error.c_str());
+				returnValue = 3;
+			} else if (!packArchive(archives[i], *prepared.stream, pack, options.compress))
+				returnValue = 3;
+
+			if (returnValue != 0)
+				queue.aborted.store(true);
+		}
+
+		prepared.close();
+		budget.release(prepared.reserved);
+
+		if (workers.empty() && (returnValue != 0))
+			break;
+	}
+
+	for (std::vector<std::thread>::iterator w = workers.begin(); w != workers.end(); ++w)
+		w->join();
+
+	if (returnValue != 0)
+		return returnValue;
+
+	if (!pack.finish()) {
+		std::printf("Error writing the name table\n");
+		return 3;
+	}
+
+	std::printf("\nPacked %u members, %u of them compressed\n", pack.getMemberCount(), pack.getCompressedCount());
+	if (budget.getLimit() != 0)
+		std::printf("At most %.1f MiB of uncompressed glues held at once\n", budget.getPeak() / (1024.0 * 1024.0));
+
+	return 0;
+}
+
+int listPack(const std::string &packFile) {
+	Common::PackFile pack;
+	if (!pack.open(packFile)) {
+		std::printf("Not a valid pack file \"%s\"\n", packFile.c_str());
+		return 3;
+	}
+
+	std::printf("Number of members: %u\n\n", pack.getMemberCount());
+
+	std::printf("       Size |     Stored | Name\n");
+	std::printf("============|============|=================\n");
+
+	Common::PackMember member;
+	for (uint32 i = 0; pack.getMember(i, member); i++)
+		std::printf(" %10u | %10u | %s\n", member.size, member.storedSize, member.name);
+
+	return 0;
+}
+
+/** Write a member into a file of the same name, creating its directories. */
+static bool extractMember(const Common::PackFile &pack, const Common::PackMember &member,
+                          const Common::OutputDirectory &output) {
+
+	if (!member.compressed)
+		return output.writeFile(member.name, pack.getStoredData(member), member.size);
+
+	byte *data = pack.uncompressMember(member);
+	if (!data)
+		return false;
+
+	bool success = output.writeFile(member.name, data, member.size);
+
+	delete[] data;
+	return success;
+}
+
+int extractPack(const std::string &packFile, const std::vector<std::string> &members) {
+	Common::PackFile pack;
+	if (!pack.open(packFile)) {
+		std::printf("Not a valid pack file \"%s\"\n", packFile.c_str());
+		return 3;
+	}
+
+	Common::OutputDirectory output;
+	if (!output.open(".")) {
+		std::printf("Error opening the current directory\n");
+		return 2;
+	}
+
+	const uint32 count = members.empty() ? pack.getMemberCount() : members.size();
+
+	std::printf("Number of members: %u\n\n", count);
+
+	int returnValue = 0;
+	for (uint32 i = 0; i < count; i++) {
+		Common::PackMember member;
+
+		bool found;
+		if (members.empty())
+			found = pack.getMember(i, member);
+		else
+			found = pack.findMember(members[i].c_str(), member);
+
+		if (!found) {
+			std::printf("No member \"%s\"\n", members[i].c_str());
+			returnValue = 3;
+			continue;
+		}
+
+		std::printf("Extracting %u/%u: \"%s\"... ", i + 1, count, member.name);
+		std::fflush(stdout);
+
+		if (extractMember(pack, member, output))
+			std::printf("done\n");
+		else
+			std::printf("FAILED\n");
+	}
+
+	return returnValue;
+}
@@ -0,0 +1,261 @@
+/* darkseed2-tools - Tools to inspect Dark Seed II resources
+ *
+ * Copyright (c) 2014, Sven Hesse (DrMcCoy) <drmccoy@drmccoy.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Dark Seed is a registered trademark of Cyberdreams, Inc. All rights reserved.
+ */
+
+/** @file ds2tools.cpp
+ *  All archive tools in a single binary.
+ *
+ *  The tool to run is picked by the name the binary was called by, so that
+ *  ds2tools can be installed as links named after the tools, or by the first
+ *  argument. A command file runs many tools one after the other within the
+ *  same process, saving the cost of starting a process for every one.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+
+#include <unistd.h>
+
+#include "common/version.h"
+#include "common/archive.h"
+#include "common/archivetool.h"
+
+typedef int (*ToolMain)(int argc, char **argv);
+
+struct Tool {
+	const char *name;
+	ToolMain main;
+};
+
+static const Tool kTools[] = {
+	{ "unpgf" , &Common::extractorMain<Common::PGFFormat>  },
+	{ "untnd" , &Common::extractorMain<Common::TNDFormat>  },
+	{ "unglue", &Common::extractorMain<Common::GlueFormat> },
+	{ "mkpgf" , &Common::creatorMain<Common::PGFFormat>    },
+	{ "mktnd" , &Common::creatorMain<Common::TNDFormat>    }
+};
+
+static const int kToolCount = sizeof(kTools) / sizeof(kTools[0]);
+
+void printUsage(FILE *stream, const char *name);
+
+const Tool *findTool(const std::string &name);
+int runTool(const Tool &tool, const std::vector<std::string> &args);
+
+int runCommandFile(const std::string &file, bool keepGoing);
+bool splitCommandLine(const std::string &line, std::vector<std::string> &args);
+
+int main(int argc, char **argv) {
+	// Called through a link named after a tool
+	const Tool *tool = findTool(Common::getFileBaseName(argv[0]));
+	if (tool)
+		return tool->main(argc, argv);
+
+	if (argc == 1) {
+		printUsage(stdout, argv[0]);
+		return 0;
+	}
+
+	// Called with the tool as the first argument
+	tool = findTool(argv[1]);
+	if (tool)
+		return tool->main(argc - 1, argv + 1);
+
+	bool keepGoing = false;
+
+	int arg = 1;
+	if ((arg < argc) && !strcmp(argv[arg], "--keep-going")) {
+		keepGoing = true;
+		arg++;
+	}
+
+	if (((argc - arg) != 2) || strcmp(argv[arg], "-f")) {
+		printUsage(stderr, argv[0]);
+		return 1;
+	}
+
+	return runCommandFile(argv[arg + 1], keepGoing);
+}
+
+void printUsage(FILE *stream, const char *name) {
+	std::fprintf(stream, "Dark Seed II archive tools\n");
+	std::fprintf(stream, "\n");
+	std::fprintf(stream, "%s\n", DS2TOOLS_NAMEVERSION);
+	std::fprintf(stream, "Copyright (c) %s, %s\n", DS2TOOLS_COPYRIGHTYEAR, DS2TOOLS_COPYRIGHTAUTHOR);
+	std::fprintf(stream, "%s\n", DS2TOOLS_URL);
+	std::fprintf(stream, "\n");
+	std::fprintf(stream, "Usage: %s <tool> [<arguments>]\n", name);
+	std::fprintf(stream, "       %s [--keep-going] -f <command file>\n", name);
+	std::fprintf(stream, "\n");
+	std::fprintf(stream, "Tools:");
+	for (int i = 0; i < kToolCount; i++)
+		std::fprintf(stream, " %s", kTools[i].name);
+	std::fprintf(stream, "\n\n");
+	std::fprintf(stream, "Linked or copied to the name of a tool, ds2tools runs as that tool.\n");
+	std::fprintf(stream, "\n");
+	std::fprintf(stream, "A command file has one tool with its arguments on every line, quoted like in\n");
+	std::fprintf(stream, "a shell. \"cd <directory>\" changes the directory for the following lines, and\n");
+	std::fprintf(stream, "lines starting with # are ignored. \"-\" reads the commands from stdin.\n");
+	std::fprintf(stream, "Running stops at the first failing line, unless --keep-going is given.\n");
+}
+
+const Tool *findTool(const std::string &name) {
+	for (int i = 0; i < kToolCount; i++)
+		if (name == kTools[i].name)
+			return &kTools[i];
+
+	return 0;
+}
+
+int runTool(const Tool &tool, const std::vector<std::string> &args) {
+	// The tools take a classic, modifiable argument vector
+	std::vector< std::vector<char> > strings(args.size());
+	std::vector<char *> argv(args.size() + 1, (char *) 0);
+
+	for (size_t i = 0; i < args.size(); i++) {
+		strings[i].assign(args[i].begin(), args[i].end());
+		strings[i].push_back('\0');
+
+		argv[i] = &strings[i][0];
+	}
+
+	int returnValue = tool.main(args.size(), &argv[0]);
+
+	// Keep the output of the tools in order with each other
+	std::fflush(stdout);
+
+	return returnValue;
+}
+
+int runCommandFile(const std::string &file, bool keepGoing) {
+	std::ifstream commandFile;
+
+	std::istream *commands = &std::cin;
+	if (file != "-") {
+		commandFile.open(file.c_str());
+		if (!commandFile.is_open()) {
+			std::printf("Error opening file \"%s\"\n", file.c_str());
+			return 2;
+		}
+
+		commands = &commandFile;
+	}
+
+	int returnValue = 0;
+
+	std::string line;
+	for (uint32 lineNumber = 1; std::getline(*commands, line); lineNumber++) {
+		std::vector<std::string> args;
+
+		int lineReturnValue = 0;
+		if (!splitCommandLine(line, args)) {
+			std::printf("Unterminated quote\n");
+			lineReturnValue = 1;
+
+		} else if (args.empty() || (args[0][0] == '#')) {
+			// Empty line or comment
+			continue;
+
+		} else if (args[0] == "cd") {
+			if ((args.size() != 2) || (chdir(args[1].c_str()) != 0)) {
+				std::printf("Can't change into directory \"%s\"\n", (args.size() > 1) ? args[1].c_str() : "");
+				lineReturnValue = 2;
+			}
+
+		} else {
+			const Tool *tool = findTool(args[0]);
+			if (tool) {
+				lineReturnValue = runTool(*tool, args);
+			} else {
+				std::printf("Unknown tool \"%s\"\n", args[0].c_str());
+				lineReturnValue = 1;
+			}
+		}
+
+		if (lineReturnValue != 0) {
+			std::printf("Line %u failed: %s\n", lineNumber, line.c_str());
+			if (returnValue == 0)
+				returnValue = lineReturnValue;
+
+			if (!keepGoing)
+				break;
+		}
+	}
+
+	return returnValue;
+}
+
+bool splitCommandLine(const std::string &line, std::vector<std::string> &args) {
+	args.clear();
+
+	std::string arg;
+	bool inArg = false;
+	char quote = 0;
+
+	for (std::string::const_iterator c = line.begin(); c != line.end(); ++c) {
+		if (quote != 0) {
+			// Within quotes, everything up to the closing quote belongs to the argument
+			if (*c == quote)
+				quote = 0;
+			else if ((quote == '"') && (*c == '\\') && ((c + 1) != line.end()) && ((c[1] == '"') || (c[1] == '\\')))
+				arg += *++c;
+			else
+				arg += *c;
+
+			continue;
+		}
+
+		if ((*c == ' ') || (*c == '\t') || (*c == '\r')) {
+			if (inArg)
+				args.push_back(arg);
+
+			arg.clear();
+			inArg = false;
+			continue;
+		}
+
+		inArg = true;
+
+		if ((*c == '"') || (*c == '\''))
+			quote = *c;
+		else if ((*c == '\\') && ((c + 1) != line.end()))
+			arg += *++c;
+		else
+			arg += *c;
+	}
+
+	if (inArg)
+		args.push_back(arg);
+
+	return quote == 0;
+}